@@ -0,0 +1,98 @@
+#include "arglist.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <system_error>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+[[noreturn]] void throwLoadError(const char* path, int code)
+{
+    throw std::system_error(code, std::generic_category(),
+                            std::string("failed to read arguments from ") + path);
+}
+
+}
+
+
+ArgList::ArgList(const char* path)
+{
+    const bool isStdin = std::string_view(path) == "-";
+    const int fd = isStdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throwLoadError(path, errno);
+    }
+
+    struct stat st;
+    const bool ok = [&] {
+        if (fstat(fd, &st) != 0) {
+            return false;
+        }
+        // Start at the current file offset, as read() would: stdin may be a file
+        // that our caller has already consumed part of.
+        const off_t offset = S_ISREG(st.st_mode) ? lseek(fd, 0, SEEK_CUR) : -1;
+        if (offset != -1 && offset < st.st_size) {
+            // mmap() requires a page-aligned offset.
+            const off_t mapOffset = offset & ~off_t(sysconf(_SC_PAGESIZE) - 1);
+            d_mapLength = st.st_size - mapOffset;
+            d_map = mmap(nullptr, d_mapLength, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+            if (d_map == MAP_FAILED) {
+                d_map = nullptr;
+                return false;
+            }
+            madvise(d_map, d_mapLength, MADV_SEQUENTIAL);
+            d_data = std::string_view(static_cast<const char*>(d_map), d_mapLength)
+                    .substr(offset - mapOffset);
+            // Leave the offset at the end, as if we had read everything.
+            lseek(fd, st.st_size, SEEK_SET);
+            return true;
+        }
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof buf)) != 0) {
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            d_buffer.append(buf, n);
+        }
+        d_data = d_buffer;
+        return true;
+    }();
+    const int savedErrno = errno;
+
+    if (!isStdin) {
+        close(fd);
+    }
+    if (!ok) {
+        throwLoadError(path, savedErrno);
+    }
+
+    // If the last argument is not NUL-terminated, keep a terminated copy of it.
+    if (!d_data.empty() && d_data.back() != '\0') {
+        const std::size_t lastStart = d_data.find_last_of('\0') + 1;  // npos + 1 == 0
+        d_unterminatedLast = d_data.substr(lastStart);
+        d_hasUnterminatedLast = true;
+        d_data.remove_suffix(d_data.size() - lastStart);
+    }
+
+    d_count = std::ranges::count(d_data, '\0') + d_hasUnterminatedLast;
+}
+
+ArgList::~ArgList()
+{
+    if (d_map) {
+        munmap(d_map, d_mapLength);
+    }
+}
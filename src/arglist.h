@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// NUL-delimited list of arguments, as given via --args-from. A regular file is
+// memory-mapped, so that the arguments can be appended to the D-Bus message
+// straight from the page cache; other inputs (e.g. a pipe) are read into a buffer.
+class ArgList {
+  public:
+    // Load the argument list from the given file, or from stdin if path is "-".
+    explicit ArgList(const char* path);
+    ~ArgList();
+
+    ArgList(const ArgList&) = delete;
+    ArgList& operator=(const ArgList&) = delete;
+
+    std::size_t count() const noexcept { return d_count; }
+
+    // Invoke func with each argument in turn, as a NUL-terminated string.
+    template<class Func>
+    void forEach(Func&& func) const
+    {
+        // d_data is guaranteed to end with a NUL byte.
+        const char* const end = d_data.data() + d_data.size();
+        for (const char* p = d_data.data(); p != end; p += std::strlen(p) + 1) {
+            func(p);
+        }
+        if (d_hasUnterminatedLast) {
+            func(d_unterminatedLast.c_str());
+        }
+    }
+
+  private:
+    void* d_map{};
+    std::size_t d_mapLength{};
+    std::string d_buffer;
+    std::string_view d_data;
+    std::string d_unterminatedLast;
+    bool d_hasUnterminatedLast{};
+    std::size_t d_count{};
+};
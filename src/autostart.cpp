@@ -0,0 +1,250 @@
+#include "autostart.h"
+#include "config.h"
+#include "executable.h"
+#include "keyfile.h"
+#include "verbose.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <ranges>
+#include <set>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool listContainsAny(std::string_view list, const std::vector<std::string_view>& items)
+{
+    for (const auto element : list | std::views::split(';')) {
+        if (std::ranges::contains(items, std::string_view(element))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+std::vector<std::string_view> currentDesktops()
+{
+    std::vector<std::string_view> desktops;
+    if (const char* xdgCurrDesktop = std::getenv("XDG_CURRENT_DESKTOP")) {
+        for (const auto desktop : std::string_view(xdgCurrDesktop) | std::views::split(':')) {
+            if (!desktop.empty()) {
+                desktops.emplace_back(desktop);
+            }
+        }
+    }
+    return desktops;
+}
+
+
+bool isExecutableAvailable(const std::string& tryExec)
+{
+    try {
+        resolveExecutable(tryExec);
+        return true;
+    }
+    catch (const std::system_error&) {
+        return false;
+    }
+}
+
+
+// Split an Exec= value into arguments and expand field codes. As there are no files
+// or URLs to open, the corresponding field codes are simply dropped.
+// https://specifications.freedesktop.org/desktop-entry-spec/latest/exec-variables.html
+std::optional<std::vector<std::string>> parseExec(std::string_view exec,
+                                                  const KeyFileGroup& keys,
+                                                  const std::string& name,
+                                                  const fs::path& path)
+{
+    std::vector<std::string> argv;
+    std::size_t i = 0;
+    while (true) {
+        while (i < exec.size() && exec[i] == ' ') {
+            ++i;
+        }
+        if (i == exec.size()) {
+            break;
+        }
+
+        std::string arg;
+
+        if (exec[i] == '"') {
+            // Quoted argument: may contain backslash escapes, but no field codes.
+            for (++i; ; ++i) {
+                if (i == exec.size()) {
+                    return {};
+                }
+                if (exec[i] == '"') {
+                    ++i;
+                    break;
+                }
+                if (exec[i] == '\\' && i + 1 < exec.size()) {
+                    ++i;
+                }
+                arg += exec[i];
+            }
+            argv.push_back(std::move(arg));
+            continue;
+        }
+
+        const std::size_t end = std::min(exec.find(' ', i), exec.size());
+        const std::string_view word = exec.substr(i, end - i);
+        i = end;
+
+        if (word == "%i") {
+            if (const std::string* icon = findKey(keys, "Icon")) {
+                argv.emplace_back("--icon");
+                argv.push_back(*icon);
+            }
+            continue;
+        }
+
+        bool droppedFieldCode = false;
+        for (std::size_t j = 0; j < word.size(); ++j) {
+            if (word[j] != '%' || j + 1 == word.size()) {
+                arg += word[j];
+                continue;
+            }
+            switch (word[++j]) {
+            case '%': arg += '%'; break;
+            case 'c': arg += name; break;
+            case 'k': arg += path.native(); break;
+            default: droppedFieldCode = true;
+            }
+        }
+        if (!arg.empty() || !droppedFieldCode) {
+            argv.push_back(std::move(arg));
+        }
+    }
+
+    if (argv.empty()) {
+        return {};
+    }
+    return argv;
+}
+
+
+std::optional<AutostartEntry> loadAutostartEntry(const fs::path& path,
+                                                 const std::vector<std::string_view>& desktops)
+{
+    const auto skip = [&](std::string_view reason) -> std::optional<AutostartEntry> {
+        verbosePrintln("Skipping autostart entry {}: {}.", path.native(), reason);
+        return {};
+    };
+
+    const std::optional<std::string> content = readFile(path);
+    if (!content) {
+        return skip("cannot read file");
+    }
+    const KeyFileGroup keys = parseKeyFileGroup(*content, "Desktop Entry");
+
+    const std::string* type = findKey(keys, "Type");
+    if (!type || *type != "Application") {
+        return skip("not of type Application");
+    }
+    if (const std::string* hidden = findKey(keys, "Hidden"); hidden && *hidden == "true") {
+        return skip("hidden");
+    }
+    if (const std::string* onlyShowIn = findKey(keys, "OnlyShowIn")) {
+        if (!listContainsAny(*onlyShowIn, desktops)) {
+            return skip("excluded by OnlyShowIn");
+        }
+    }
+    if (const std::string* notShowIn = findKey(keys, "NotShowIn")) {
+        if (listContainsAny(*notShowIn, desktops)) {
+            return skip("excluded by NotShowIn");
+        }
+    }
+    if (const std::string* tryExec = findKey(keys, "TryExec")) {
+        if (!isExecutableAvailable(*tryExec)) {
+            return skip("TryExec program not found");
+        }
+    }
+
+    AutostartEntry entry;
+    entry.id = path.stem().native();
+
+    const std::string* name = findKey(keys, "Name");
+    entry.name = name ? *name : entry.id;
+
+    const std::string* exec = findKey(keys, "Exec");
+    if (!exec) {
+        return skip("no Exec key");
+    }
+    if (auto argv = parseExec(*exec, keys, entry.name, path)) {
+        entry.exec = std::move(*argv);
+    }
+    else {
+        return skip("invalid Exec value");
+    }
+
+    if (const std::string* workingDir = findKey(keys, "Path"); workingDir && !workingDir->empty()) {
+        entry.workingDir = *workingDir;
+    }
+
+    if (const std::string* priority = findKey(keys, "X-Runapp-Priority")) {
+        const char* end = priority->data() + priority->size();
+        if (std::from_chars(priority->data(), end, entry.priority).ptr != end) {
+            return skip("invalid X-Runapp-Priority value");
+        }
+    }
+
+    return entry;
+}
+
+} // namespace
+
+
+std::vector<AutostartEntry> findAutostartEntries()
+{
+    // https://specifications.freedesktop.org/autostart-spec/latest/
+
+    std::vector<fs::path> configDirs;  // in order of decreasing precedence
+    if (std::optional<fs::path> configHome = configHomeDir()) {
+        configDirs.push_back(std::move(*configHome));
+    }
+    const char* xdgConfigDirs = std::getenv("XDG_CONFIG_DIRS");
+    if (!xdgConfigDirs || !*xdgConfigDirs) {
+        xdgConfigDirs = "/etc/xdg";
+    }
+    for (const auto dir : std::string_view(xdgConfigDirs) | std::views::split(':')) {
+        if (!dir.empty()) {
+            configDirs.emplace_back(std::string_view(dir));
+        }
+    }
+
+    const std::vector<std::string_view> desktops = currentDesktops();
+
+    // An entry in a directory of higher precedence hides all same-named entries in
+    // directories of lower precedence, even if the former is itself skipped (e.g. Hidden=true).
+    std::set<fs::path> seenFilenames;
+    std::vector<AutostartEntry> entries;
+
+    for (const fs::path& configDir : configDirs) {
+        std::error_code ec;
+        for (const fs::directory_entry& file : fs::directory_iterator(configDir / "autostart", ec)) {
+            const fs::path& path = file.path();
+            if (path.extension() != ".desktop" || !seenFilenames.insert(path.filename()).second) {
+                continue;
+            }
+            if (auto entry = loadAutostartEntry(path, desktops)) {
+                entries.push_back(std::move(*entry));
+            }
+        }
+    }
+
+    std::ranges::sort(entries, {}, [](const AutostartEntry& e) {
+        return std::tie(e.priority, e.id);
+    });
+
+    return entries;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+struct AutostartEntry {
+    std::string id;    // desktop file ID, without ".desktop" suffix
+    std::string name;  // Name= value, or id if absent
+    std::vector<std::string> exec;  // Exec= value, split into arguments, field codes expanded
+    std::optional<std::string> workingDir;  // Path= value
+    int priority{};  // X-Runapp-Priority= value; entries with lower values are started first
+};
+
+// Return the XDG autostart entries that apply to the current desktop, ordered by priority.
+std::vector<AutostartEntry> findAutostartEntries();
@@ -0,0 +1,40 @@
+#include "auxunits.h"
+#include "unitname.h"
+
+#include <format>
+
+
+SocketUnits describeSocketUnits(std::string_view serviceName, unsigned idleExitSec,
+                                const std::filesystem::path& runtimeDir,
+                                const std::filesystem::path& socketProxyd)
+{
+    SocketUnits units;
+    if (!idleExitSec) {
+        units.listenerName = socketUnitName(serviceName);
+        return units;
+    }
+
+    // systemd pairs the app's service with its socket by name, so the listener is
+    // named after the proxy service.
+    units.proxyName = proxyUnitName(serviceName);
+    units.listenerName = socketUnitName(units.proxyName);
+    units.backendName = socketUnitName(serviceName);
+
+    const std::size_t at = serviceName.rfind('@') + 1;
+    units.backendPath = runtimeDir / "runapp"
+            / std::format("{}.sock", serviceName.substr(at, serviceName.rfind('.') - at));
+
+    units.proxyCommand = {
+        socketProxyd.native(),
+        std::format("--exit-idle-time={}s", idleExitSec),
+        units.backendPath.native(),
+    };
+    return units;
+}
+
+
+std::vector<std::string> boostEndCommand(std::string_view unitName)
+{
+    return {"systemctl", "--user", "set-property", "--runtime", std::string(unitName),
+            "CPUWeight=", "IOWeight="};
+}
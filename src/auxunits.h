@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The auxiliary units that runapp starts along with an app's own unit: the socket
+// units and proxy service of --socket and --idle-exit, and the service that ends a
+// --boost window. They are described here by their names, addresses and command
+// lines; main.cpp turns them into StartTransientUnit requests.
+
+struct SocketUnits {
+    std::string listenerName;  // the socket unit listening on the --socket address
+    // With --idle-exit, the listener starts the proxy service instead of the app's
+    // service, which listens on a private Unix socket of its own; otherwise, these are
+    // empty.
+    std::string backendName;  // the socket unit of the app's service
+    std::filesystem::path backendPath;  // the Unix socket it listens on
+    std::string proxyName;
+    std::vector<std::string> proxyCommand;  // ExecStart=, argv[0] being the executable
+};
+
+// Describe the socket units for the given app service with --socket, and if
+// idleExitSec is non-zero, with --idle-exit after that many seconds, where
+// 'socketProxyd' is the path of systemd-socket-proxyd. The backend socket is named
+// after the service's instance (the random part of its name) in
+// 'runtimeDir'/runapp, so as to stay well within the length limit of socket paths.
+SocketUnits describeSocketUnits(std::string_view serviceName, unsigned idleExitSec,
+                                const std::filesystem::path& runtimeDir,
+                                const std::filesystem::path& socketProxyd);
+
+// Return the command line that ends the --boost window of the given unit, by resetting
+// its CPU and IO weights to their defaults (which an empty assignment does).
+std::vector<std::string> boostEndCommand(std::string_view unitName);
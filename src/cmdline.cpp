@@ -1,9 +1,19 @@
 #include "cmdline.h"
+#include "output.h"
+#include "unitname.h"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
-#include <iostream>
-#include <print>
+#include <cstring>
+#include <filesystem>
+#include <ranges>
+#include <string>
 #include <string_view>
+#include <system_error>
 #include <utility>
 
 #include <getopt.h>
@@ -18,9 +28,25 @@ constexpr char UsageStr[] =
     "    -v, --verbose: Increase output verbosity.\n"
     "    -o, --scope:   Run command directly, registering it as a systemd scope;\n"
     "                   the default is to run it as a systemd service.\n"
+    "    -t, --template:\n"
+    "                   Run command as an instance of a generated template service\n"
+    "                   (installed under $XDG_RUNTIME_DIR/systemd/user), rather than\n"
+    "                   as a fully transient service; cheaper for systemd when\n"
+    "                   launching the same app repeatedly. Not supported with\n"
+    "                   -d/--dir.\n"
     "    -i SLICE, --slice=SLICE:\n"
     "                   Assign the systemd unit to the given slice (name must include\n"
     "                   \".slice\" suffix); the default is \"app-graphical.slice\".\n"
+    "    -b, --background:\n"
+    "                   Assign the systemd unit to \"background-graphical.slice\", for\n"
+    "                   background work (sync clients, indexers, ...); runapp creates\n"
+    "                   the slice if it does not exist, and then gives its parent\n"
+    "                   background.slice low CPU and IO weights (relative to\n"
+    "                   app.slice).\n"
+    "    -s, --session: Assign the systemd unit to \"session-graphical.slice\", for\n"
+    "                   core session components; runapp creates the slice if it does\n"
+    "                   not exist, and then gives its parent session.slice high CPU\n"
+    "                   and IO weights, and both some memory protection.\n"
     "    -d DIR, --dir=DIR:\n"
     "                   Run command in given working directory.\n"
     "    -e VAR=VALUE, --env=VAR=VALUE:\n"
@@ -29,10 +55,160 @@ constexpr char UsageStr[] =
     "    -c DESC, --description=DESC:\n"
     "                   Set human-readable unit name (Description= systemd property)\n"
     "                   to given value.\n"
+    "    -f FILE, --args-from=FILE:\n"
+    "                   Append the NUL-delimited arguments read from FILE (or from\n"
+    "                   stdin, if FILE is \"-\") to COMMAND; avoids the ARG_MAX limit\n"
+    "                   for very long argument lists (up to 1 MiB when quoted, as\n"
+    "                   systemd stores them in a unit file line). Not supported with\n"
+    "                   -o/--scope or -t/--template.\n"
+    "    -D MS, --deadline=MS:\n"
+    "                   Give up waiting for systemd once MS milliseconds have passed\n"
+    "                   since runapp started, and fail (but see -x/--deadline-exec),\n"
+    "                   canceling the launch.\n"
+    "    -x, --deadline-exec:\n"
+    "                   When the -D/--deadline passes, execute the command directly\n"
+    "                   instead of failing, and move it into a systemd scope once\n"
+    "                   systemd responds again.\n"
+    "    -B SECONDS, --boost=SECONDS:\n"
+    "                   Start the unit with raised CPU and IO weights, and drop them\n"
+    "                   back to normal after SECONDS seconds (0 disables boosting,\n"
+    "                   e.g. if enabled for the app in runapp.conf).\n"
+    "    -O TARGET, --output=TARGET:\n"
+    "                   Send the command's stdout and stderr to TARGET: \"journal\"\n"
+    "                   (the default for services), \"null\", or \"file:PATH\" (which is\n"
+    "                   truncated when the command starts, but not size-capped).\n"
+    "    --log-rate-limit=SECONDS:BURST:\n"
+    "                   Make the journal drop the command's messages beyond BURST\n"
+    "                   messages per SECONDS seconds (0:0 disables rate limiting).\n"
+    "                   Not supported with -o/--scope.\n"
+    "    --log-level-max=LEVEL:\n"
+    "                   Make the journal drop the command's messages of lower priority\n"
+    "                   than LEVEL (a syslog level: emerg, alert, crit, err, warning,\n"
+    "                   notice, info, debug, or 0-7). Not supported with -o/--scope.\n"
+    "    --delegate[=CONTROLLERS]:\n"
+    "                   Delegate the unit's cgroup subtree to the command, which starts\n"
+    "                   in its \"main\" subgroup and may create further subgroups next\n"
+    "                   to it; CONTROLLERS is a comma-separated list (of cpu, cpuset,\n"
+    "                   io, memory and pids) to enable for it, the default being all.\n"
+    "                   The subtree's directory is passed in $RUNAPP_DELEGATED_CGROUP.\n"
+    "    --socket=PATH|PORT:\n"
+    "                   Do not run the command yet, but listen on the Unix socket PATH\n"
+    "                   (or on TCP port PORT of the loopback interface) in a systemd\n"
+    "                   socket unit, and run the command as a service on the first\n"
+    "                   connection, passing it the listening socket (as with\n"
+    "                   sd_listen_fds()). Not supported with -o/--scope, -t/--template,\n"
+    "                   -x/--deadline-exec or -B/--boost. Any local user may connect\n"
+    "                   to a TCP port; a Unix socket is only accessible to you.\n"
+    "    --idle-exit=SECONDS:\n"
+    "                   With --socket, stop the command once no connection has been\n"
+    "                   open for SECONDS seconds (it is started again on the next),\n"
+    "                   by passing connections through systemd-socket-proxyd.\n"
+    "    --group=NAME:  Assign the systemd unit to the slice of the app group NAME,\n"
+    "                   which runapp creates as a child of the slice that the unit\n"
+    "                   would be in otherwise, so that all apps launched with the same\n"
+    "                   NAME share the resource limits below (defaults for which may\n"
+    "                   be given in a [Group NAME] section of runapp.conf).\n"
+    "    --memory-max=BYTES, --memory-high=BYTES:\n"
+    "                   Set the hard (MemoryMax=) or soft (MemoryHigh=) memory limit\n"
+    "                   of the --group; BYTES may have a K, M, G or T suffix.\n"
+    "    --cpu-quota=PERCENT:\n"
+    "                   Limit the --group to PERCENT% of the time of one CPU.\n"
+    "                   Limits that are not given are left as they are on the group's\n"
+    "                   slice; \"infinity\" lifts a limit.\n"
+    "\n"
+    "{0} [OPTIONS] --autostart\n"
+    "    Start the XDG autostart entries for the current desktop, each as a systemd\n"
+    "    user service, and report how long each took to start. The -v, -i, -b, -s,\n"
+    "    -e, -O, --log-rate-limit and --log-level-max options apply as above.\n"
+    "    Additional option:\n"
+    "\n"
+    "    -j N, --jobs=N:\n"
+    "                   Start at most N entries concurrently; the default is 8.\n"
+    "\n"
+    "{0} [OPTIONS] --prewarm[=N]\n"
+    "    Read the executables and shared libraries of the N apps (default: 10) most\n"
+    "    frequently and recently launched via runapp into the page cache, at idle IO\n"
+    "    priority, from a systemd scope in background-graphical.slice (or the slice\n"
+    "    given via -i). Meant to be run at login, so that the first launch of each\n"
+    "    app finds a warm cache. The -v and -i options apply as above.\n"
+    "\n"
+    "{0} [OPTIONS] --stop PATTERN...\n"
+    "    Stop all running units that match any PATTERN, which is either a unit name\n"
+    "    or glob pattern with a unit type suffix (e.g. \"app-*.service\", or a slice),\n"
+    "    or an app name, matching all units runapp started for that app. Reports how\n"
+    "    long each unit took to stop. The -v option applies as above. Additional\n"
+    "    option:\n"
+    "\n"
+    "    --stop-timeout=SECONDS:\n"
+    "                   Kill (SIGKILL) units that have not stopped after SECONDS\n"
+    "                   seconds, rather than after their TimeoutStopSec=.\n"
+    "\n"
+    "{0} --latency-report[=json]\n"
+    "    Print percentiles of the launch latencies recorded by previous invocations,\n"
+    "    per app and mode (service, scope or template), broken down into the phases\n"
+    "    connect, prepare, reply and job (plus the total); optionally as JSON.\n"
     "\n"
     "{0} --help\n"
     "    Show this help text.\n";
 
+
+bool parseUnsigned(const char* str, unsigned& result)
+{
+    const char* end = str + std::strlen(str);
+    auto [ptr, ec] = std::from_chars(str, end, result);
+    return ec == std::errc() && ptr == end;
+}
+
+
+bool parsePositive(const char* str, unsigned& result)
+{
+    return parseUnsigned(str, result) && result > 0;
+}
+
+
+// Parse the comma-separated list of cgroup controllers given to --delegate.
+std::optional<std::vector<std::string>> parseControllers(std::string_view value)
+{
+    constexpr std::array<std::string_view, 5> known = {"cpu", "cpuset", "io", "memory", "pids"};
+    if (value.empty()) {
+        return {};  // all controllers is spelled without the '='
+    }
+    std::vector<std::string> controllers;
+    for (const auto part : value | std::views::split(',')) {
+        const std::string_view controller(part);
+        if (!std::ranges::contains(known, controller)) {
+            return {};
+        }
+        if (!std::ranges::contains(controllers, controller)) {
+            controllers.emplace_back(controller);
+        }
+    }
+    return controllers;
+}
+
+
+// Parse the argument of --socket into a ListenStream= address: a port number is
+// taken to be one on the loopback interface, as the apps in question are local helpers.
+std::optional<std::string> parseSocketAddress(std::string_view value)
+{
+    unsigned port{};
+    const char* end = value.data() + value.size();
+    if (auto [ptr, ec] = std::from_chars(value.data(), end, port); ptr == end) {
+        if (ec != std::errc() || port == 0 || port > 65535) {
+            return {};
+        }
+        return std::format("127.0.0.1:{}", port);
+    }
+
+    // Anything else is a path; relative ones are relative to our working directory.
+    std::error_code ec;
+    const std::filesystem::path path = std::filesystem::absolute(value, ec);
+    if (value.empty() || ec) {
+        return {};
+    }
+    return path.native();
+}
+
 }
 
 
@@ -47,16 +223,39 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
     // The subsequent ':' makes getopt_long() not print parse errors
     // directly but instead return either '?' or ':' for different kinds
     // of errors.
-    const char* shortOptions = "+:voi:d:e:c:";
+    const char* shortOptions = "+:voti:bsd:e:c:f:D:xB:O:aj:";
 
     const option longOptions[] = {
         { "help",        no_argument,       nullptr, 'h' },
         { "verbose",     no_argument,       nullptr, 'v' },
         { "scope",       no_argument,       nullptr, 'o' },
+        { "template",    no_argument,       nullptr, 't' },
         { "slice",       required_argument, nullptr, 'i' },
+        { "background",  no_argument,       nullptr, 'b' },
+        { "session",     no_argument,       nullptr, 's' },
         { "dir",         required_argument, nullptr, 'd' },
         { "env",         required_argument, nullptr, 'e' },
         { "description", required_argument, nullptr, 'c' },
+        { "args-from",   required_argument, nullptr, 'f' },
+        { "deadline",    required_argument, nullptr, 'D' },
+        { "deadline-exec", no_argument,     nullptr, 'x' },
+        { "boost",       required_argument, nullptr, 'B' },
+        { "output",      required_argument, nullptr, 'O' },
+        { "log-rate-limit", required_argument, nullptr, 'R' },  // long option only
+        { "log-level-max", required_argument, nullptr, 'M' },   // long option only
+        { "delegate",    optional_argument, nullptr, 'G' },  // long option only
+        { "socket",      required_argument, nullptr, 'K' },  // long option only
+        { "idle-exit",   required_argument, nullptr, 'E' },  // long option only
+        { "group",       required_argument, nullptr, 'N' },  // long option only
+        { "memory-max",  required_argument, nullptr, 'X' },  // long option only
+        { "memory-high", required_argument, nullptr, 'H' },  // long option only
+        { "cpu-quota",   required_argument, nullptr, 'Q' },  // long option only
+        { "autostart",   no_argument,       nullptr, 'a' },
+        { "jobs",        required_argument, nullptr, 'j' },
+        { "prewarm",     optional_argument, nullptr, 'W' },  // long option only
+        { "latency-report", optional_argument, nullptr, 'L' },  // long option only
+        { "stop",        no_argument,       nullptr, 'S' },  // long option only
+        { "stop-timeout", required_argument, nullptr, 'T' },  // long option only
         { }
     };
 
@@ -69,24 +268,31 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
         return "<unknown>";
     };
 
+    const auto optionName = [&](char c) {
+        if (std::strchr(shortOptions, c)) {
+            return std::format("-{}/--{}", c, shortToLongOption(c));
+        }
+        return std::format("--{}", shortToLongOption(c));
+    };
+
     const auto printUsage = [&]() {
-        std::print(std::cout, UsageStr, argv[0]);
+        fdPrint(STDOUT_FILENO, UsageStr, argv[0]);
     };
 
     const auto printErr = [&]<class... Args>(std::format_string<Args...> fmt, Args&&... args)
     {
         printUsage();
-        // std::clog is like std::cerr but without automatic flushing.
-        std::print(std::clog, "\nError: ");
-        std::print(std::clog, fmt, std::forward<Args>(args)...);
-        std::println(std::cerr, ".");
+        fdPrintln(STDERR_FILENO, "\nError: {}.", std::format(fmt, std::forward<Args>(args)...));
     };
 
     int opt{};
+    bool haveNonHelpOption = false;
+    bool haveOtherOption = false;  // other than --latency-report
+    bool haveOtherThanStopOption = false;  // other than -v, --stop and --stop-timeout
 
     const auto checkAssignOnce = [&](auto& option, const auto& value) {
         if (option) {
-            printErr("-{}/--{} may only be given once", char(opt), shortToLongOption(opt));
+            printErr("{} may only be given once", optionName(opt));
             return false;
         }
         option = value;
@@ -94,6 +300,9 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
     };
 
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, nullptr)) != -1) {
+        haveNonHelpOption |= opt != 'h';
+        haveOtherOption |= opt != 'L';
+        haveOtherThanStopOption |= !std::strchr("vST", opt);
         switch (opt) {
         case 'h':
             args.isHelp = true;
@@ -108,12 +317,27 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
                 return {};
             }
             break;
+        case 't':
+            if (!checkAssignOnce(args.isTemplate, true)) {
+                return {};
+            }
+            break;
         case 'i':
             if (!checkAssignOnce(args.slice, optarg)) {
                 return {};
             }
             if (!std::string_view(args.slice.value()).ends_with(".slice")) {
-                printErr("--i/--slice argument must end with \".slice\"");
+                printErr("-i/--slice argument must end with \".slice\"");
+                return {};
+            }
+            break;
+        case 'b':
+            if (!checkAssignOnce(args.isBackground, true)) {
+                return {};
+            }
+            break;
+        case 's':
+            if (!checkAssignOnce(args.isSession, true)) {
                 return {};
             }
             break;
@@ -134,6 +358,195 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
                 return {};
             }
             break;
+        case 'f':
+            if (!checkAssignOnce(args.argsFrom, optarg)) {
+                return {};
+            }
+            break;
+        case 'D': {
+            unsigned deadlineMs{};
+            if (!parsePositive(optarg, deadlineMs)) {
+                printErr("-D/--deadline argument must be a positive integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.deadlineMs, deadlineMs)) {
+                return {};
+            }
+            break;
+        }
+        case 'x':
+            if (!checkAssignOnce(args.isDeadlineExec, true)) {
+                return {};
+            }
+            break;
+        case 'B': {
+            unsigned boostSec{};
+            if (!parseUnsigned(optarg, boostSec)) {
+                printErr("-B/--boost argument must be a non-negative integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.boostSec, boostSec)) {
+                return {};
+            }
+            break;
+        }
+        case 'O': {
+            const std::optional<OutputTarget> output = parseOutputTarget(optarg);
+            if (!output) {
+                printErr("-O/--output argument must be \"journal\", \"null\" or \"file:PATH\"");
+                return {};
+            }
+            if (!checkAssignOnce(args.output, *output)) {
+                return {};
+            }
+            break;
+        }
+        case 'R': {
+            const std::optional<LogRateLimit> limit = parseLogRateLimit(optarg);
+            if (!limit) {
+                printErr("--log-rate-limit argument must be of the form SECONDS:BURST");
+                return {};
+            }
+            if (!checkAssignOnce(args.logRateLimit, *limit)) {
+                return {};
+            }
+            break;
+        }
+        case 'M': {
+            const std::optional<int> level = parseLogLevel(optarg);
+            if (!level) {
+                printErr("--log-level-max argument must be a syslog level name or 0-7");
+                return {};
+            }
+            if (!checkAssignOnce(args.logLevelMax, *level)) {
+                return {};
+            }
+            break;
+        }
+        case 'G': {
+            std::optional<std::vector<std::string>> controllers =
+                    optarg ? parseControllers(optarg) : std::vector<std::string>();
+            if (!controllers) {
+                printErr("--delegate argument must be a comma-separated list of cgroup "
+                         "controllers (cpu, cpuset, io, memory, pids)");
+                return {};
+            }
+            if (!checkAssignOnce(args.delegateControllers, std::move(*controllers))) {
+                return {};
+            }
+            break;
+        }
+        case 'K': {
+            std::optional<std::string> address = parseSocketAddress(optarg);
+            if (!address) {
+                printErr("--socket argument must be a path or a port number (1-65535)");
+                return {};
+            }
+            if (!checkAssignOnce(args.socket, std::move(*address))) {
+                return {};
+            }
+            break;
+        }
+        case 'E': {
+            unsigned idleExitSec{};
+            if (!parsePositive(optarg, idleExitSec)) {
+                printErr("--idle-exit argument must be a positive integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.idleExitSec, idleExitSec)) {
+                return {};
+            }
+            break;
+        }
+        case 'N':
+            // As escaped for the name of the group's slice, see unitSlice().
+            if (!*optarg || escapeUnitNameComponent(optarg).size() > 64) {
+                printErr("--group argument must be 1 to 64 characters long, counting "
+                         "4 for each character other than letters, digits, ':', '_' and '.'");
+                return {};
+            }
+            if (!checkAssignOnce(args.group, optarg)) {
+                return {};
+            }
+            break;
+        case 'X':
+        case 'H': {
+            const std::optional<std::uint64_t> bytes = parseByteSize(optarg);
+            if (!bytes) {
+                printErr("{} argument must be a number of bytes, optionally with a K, M, G "
+                         "or T suffix, or \"infinity\"", optionName(opt));
+                return {};
+            }
+            auto& limit = opt == 'X' ? args.groupLimits.memoryMax : args.groupLimits.memoryHigh;
+            if (!checkAssignOnce(limit, *bytes)) {
+                return {};
+            }
+            break;
+        }
+        case 'Q': {
+            const std::optional<unsigned> percent = parsePercentage(optarg);
+            if (!percent) {
+                printErr("--cpu-quota argument must be a positive percentage or \"infinity\"");
+                return {};
+            }
+            if (!checkAssignOnce(args.groupLimits.cpuQuotaPercent, *percent)) {
+                return {};
+            }
+            break;
+        }
+        case 'a':
+            if (!checkAssignOnce(args.isAutostart, true)) {
+                return {};
+            }
+            break;
+        case 'j': {
+            unsigned jobs{};
+            if (!parsePositive(optarg, jobs)) {
+                printErr("-j/--jobs argument must be a positive integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.jobs, jobs)) {
+                return {};
+            }
+            break;
+        }
+        case 'W': {
+            unsigned appCount = 10;
+            if (optarg && !parsePositive(optarg, appCount)) {
+                printErr("--prewarm argument must be a positive integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.prewarm, appCount)) {
+                return {};
+            }
+            break;
+        }
+        case 'L':
+            if (optarg && std::string_view(optarg) != "json") {
+                printErr("--latency-report argument must be \"json\", if given");
+                return {};
+            }
+            if (!checkAssignOnce(args.isLatencyReport, true)) {
+                return {};
+            }
+            args.isLatencyReportJson = optarg != nullptr;
+            break;
+        case 'S':
+            if (!checkAssignOnce(args.isStop, true)) {
+                return {};
+            }
+            break;
+        case 'T': {
+            unsigned timeoutSec{};
+            if (!parsePositive(optarg, timeoutSec)) {
+                printErr("--stop-timeout argument must be a positive integer");
+                return {};
+            }
+            if (!checkAssignOnce(args.stopTimeoutSec, timeoutSec)) {
+                return {};
+            }
+            break;
+        }
         case '?':
             if (optopt == 0) {
                 printErr("Invalid option: {}", argv[optind - 1]);
@@ -143,8 +556,7 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
             }
             return {};
         case ':':
-            printErr("Missing argument for option: -{}/--{}",
-                     char(optopt), shortToLongOption(char(optopt)));
+            printErr("Missing argument for option: {}", optionName(optopt));
             return {};
         default:
             printErr("Unknown argument parsing error");
@@ -153,9 +565,7 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
     }
 
     if (args.isHelp) {
-        if (optind < argc || args.isVerbose || args.isScope || args.slice
-            || args.workingDir || args.description || !args.env.empty())
-        {
+        if (optind < argc || haveNonHelpOption) {
             printErr("--help may not be combined with any other options or arguments");
             return {};
         }
@@ -163,11 +573,136 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
         return args;
     }
 
+    if (args.isLatencyReport) {
+        if (optind < argc || haveOtherOption) {
+            printErr("--latency-report may not be combined with any other options or arguments");
+            return {};
+        }
+        return args;
+    }
+
+    if (args.isStop) {
+        if (optind == argc) {
+            printErr("--stop requires at least one PATTERN");
+            return {};
+        }
+        if (haveOtherThanStopOption) {
+            printErr("--stop may only be combined with -v/--verbose and --stop-timeout");
+            return {};
+        }
+        args.args = std::span(const_cast<const char**>(&argv[optind]), argc - optind);
+        return args;
+    }
+
+    if (args.stopTimeoutSec) {
+        printErr("--stop-timeout may only be given together with --stop");
+        return {};
+    }
+
+    if (!args.groupLimits.empty() && !args.group) {
+        printErr("--memory-max, --memory-high and --cpu-quota require --group");
+        return {};
+    }
+
+    if (int(bool(args.slice)) + args.isBackground + args.isSession > 1) {
+        printErr("only one of -i/--slice, -b/--background and -s/--session may be given");
+        return {};
+    }
+
+    if (args.prewarm) {
+        if (optind < argc) {
+            printErr("--prewarm does not take a command");
+            return {};
+        }
+        if (args.isScope || args.isTemplate || args.isBackground || args.isSession
+            || args.workingDir || !args.env.empty()
+            || args.description || args.argsFrom || args.deadlineMs || args.isDeadlineExec
+            || args.boostSec || args.output || args.logRateLimit || args.logLevelMax
+            || args.delegateControllers || args.socket || args.idleExitSec || args.group
+            || args.isAutostart || args.jobs)
+        {
+            printErr("--prewarm may only be combined with -v/--verbose and -i/--slice");
+            return {};
+        }
+        return args;
+    }
+
+    if (args.isAutostart) {
+        if (optind < argc) {
+            printErr("--autostart does not take a command");
+            return {};
+        }
+        if (args.isScope || args.isTemplate || args.workingDir || args.description
+            || args.argsFrom || args.deadlineMs || args.isDeadlineExec || args.boostSec
+            || args.delegateControllers || args.socket || args.idleExitSec || args.group)
+        {
+            printErr("--autostart may not be combined with -o/--scope, -t/--template, "
+                     "-d/--dir, -c/--description, -f/--args-from, -D/--deadline, "
+                     "-B/--boost, --delegate, --socket, --idle-exit or --group");
+            return {};
+        }
+        return args;
+    }
+
+    if (args.jobs) {
+        printErr("-j/--jobs may only be given together with --autostart");
+        return {};
+    }
+
     if (optind == argc) {
         printErr("Missing command");
         return {};
     }
 
+    if (args.isScope && args.isTemplate) {
+        printErr("-o/--scope may not be combined with -t/--template");
+        return {};
+    }
+
+    if (args.isTemplate && args.workingDir) {
+        // WorkingDirectory= does not expand environment variables, so it cannot be
+        // passed per instance, and baking it into the template would give each
+        // directory a template of its own.
+        printErr("-d/--dir may not be combined with -t/--template");
+        return {};
+    }
+
+    if (args.isScope && (args.logRateLimit || args.logLevelMax)) {
+        // journald applies these according to the settings of the unit that the
+        // logging process belongs to, which scopes do not have.
+        printErr("--log-rate-limit and --log-level-max may not be combined with -o/--scope");
+        return {};
+    }
+
+    if (args.isDeadlineExec && !args.deadlineMs) {
+        printErr("-x/--deadline-exec requires -D/--deadline");
+        return {};
+    }
+
+    if (args.isDeadlineExec && args.argsFrom) {
+        printErr("-x/--deadline-exec may not be combined with -f/--args-from");
+        return {};
+    }
+
+    if (args.socket && (args.isScope || args.isTemplate || args.isDeadlineExec || args.boostSec)) {
+        // The command is not run until later, by systemd, so neither can we run it
+        // directly, nor is there a startup phase to boost.
+        printErr("--socket may not be combined with -o/--scope, -t/--template, "
+                 "-x/--deadline-exec or -B/--boost");
+        return {};
+    }
+
+    if (args.idleExitSec && !args.socket) {
+        printErr("--idle-exit requires --socket");
+        return {};
+    }
+
+    if (args.argsFrom && (args.isScope || args.isTemplate)) {
+        // In scope mode, we would be subject to ARG_MAX again when executing the command.
+        printErr("-f/--args-from may not be combined with -o/--scope or -t/--template");
+        return {};
+    }
+
     if (!args.description) {
         if (const char* envName = std::getenv("DESKTOP_ENTRY_NAME")) {
             args.description = envName;
@@ -178,3 +713,106 @@ std::optional<CmdlineArgs> parseArgs(int argc, char* argv[])
 
     return args;
 }
+
+
+std::optional<OutputTarget> parseOutputTarget(std::string_view value)
+{
+    if (value == "journal") {
+        return OutputTarget{OutputTarget::Kind::Journal, {}};
+    }
+    if (value == "null") {
+        return OutputTarget{OutputTarget::Kind::Null, {}};
+    }
+    constexpr std::string_view filePrefix = "file:";
+    if (value.starts_with(filePrefix) && value.size() > filePrefix.size()) {
+        std::error_code ec;
+        const std::filesystem::path path =
+                std::filesystem::absolute(value.substr(filePrefix.size()), ec);
+        if (!ec) {
+            return OutputTarget{OutputTarget::Kind::File, path.native()};
+        }
+    }
+    return {};
+}
+
+
+std::optional<LogRateLimit> parseLogRateLimit(std::string_view value)
+{
+    const std::size_t colon = value.find(':');
+    if (colon == std::string_view::npos) {
+        return {};
+    }
+    const auto parsePart = [](std::string_view part, unsigned& result) {
+        const char* end = part.data() + part.size();
+        auto [ptr, ec] = std::from_chars(part.data(), end, result);
+        return !part.empty() && ec == std::errc() && ptr == end;
+    };
+    LogRateLimit limit{};
+    if (!parsePart(value.substr(0, colon), limit.intervalSec)
+        || !parsePart(value.substr(colon + 1), limit.burst))
+    {
+        return {};
+    }
+    return limit;
+}
+
+
+std::optional<int> parseLogLevel(std::string_view value)
+{
+    constexpr std::array<std::string_view, 8> names = {
+        "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+    };
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (value == names[i] || (value.size() == 1 && value[0] == char('0' + i))) {
+            return int(i);
+        }
+    }
+    return {};
+}
+
+
+std::optional<std::uint64_t> parseByteSize(std::string_view value)
+{
+    if (value == "infinity") {
+        return UINT64_MAX;
+    }
+    std::uint64_t number{};
+    const char* end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, number);
+    if (ec != std::errc() || ptr == value.data()) {
+        return {};
+    }
+
+    // Binary multiples, as in systemd's own resource control settings.
+    constexpr std::string_view suffixes = "KMGT";
+    unsigned shift = 0;
+    if (ptr != end) {
+        const std::size_t index = suffixes.find(*ptr);
+        if (index == std::string_view::npos || ptr + 1 != end) {
+            return {};
+        }
+        shift = 10 * (index + 1);
+    }
+    if (number > (UINT64_MAX >> shift)) {
+        return {};
+    }
+    return number << shift;
+}
+
+
+std::optional<unsigned> parsePercentage(std::string_view value)
+{
+    if (value == "infinity") {
+        return UINT_MAX;
+    }
+    if (value.ends_with('%')) {
+        value.remove_suffix(1);
+    }
+    unsigned percent{};
+    const char* end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, percent);
+    if (ec != std::errc() || ptr != end || percent == 0) {
+        return {};
+    }
+    return percent;
+}
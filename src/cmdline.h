@@ -1,18 +1,78 @@
+#pragma once
+
+#include <cstdint>
 #include <optional>
 #include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
+// Destination of an app's stdout and stderr (-O/--output).
+struct OutputTarget {
+    enum class Kind { Journal, Null, File };
+    Kind kind;
+    std::string path;  // absolute; only used with Kind::File
+};
+
+// Rate limit for an app's messages to the journal (--log-rate-limit).
+struct LogRateLimit {
+    unsigned intervalSec;
+    unsigned burst;
+};
+
+// Resource limits shared by the apps of a group (--group), set on the group's slice.
+struct GroupLimits {
+    std::optional<std::uint64_t> memoryMax;   // bytes
+    std::optional<std::uint64_t> memoryHigh;  // bytes
+    std::optional<unsigned> cpuQuotaPercent;  // 100 being one CPU
+
+    bool empty() const { return !memoryMax && !memoryHigh && !cpuQuotaPercent; }
+};
+
 struct CmdlineArgs {
     bool isHelp{};
     bool isVerbose{};
     bool isScope{};
+    bool isTemplate{};
+    bool isBackground{};
+    bool isSession{};
+    bool isAutostart{};
+    std::optional<unsigned> jobs;
+    std::optional<unsigned> prewarm;  // number of apps, if --prewarm was given
+    bool isLatencyReport{};
+    bool isLatencyReportJson{};
+    bool isStop{};
+    std::optional<unsigned> stopTimeoutSec;
+    std::optional<unsigned> deadlineMs;
+    bool isDeadlineExec{};
+    std::optional<unsigned> boostSec;
+    std::optional<OutputTarget> output;
+    std::optional<LogRateLimit> logRateLimit;
+    std::optional<int> logLevelMax;  // syslog level
+    // Set if --delegate was given; empty means all controllers.
+    std::optional<std::vector<std::string>> delegateControllers;
+    // Set if --socket was given: the address to listen on, as for ListenStream=.
+    std::optional<std::string> socket;
+    std::optional<unsigned> idleExitSec;  // --idle-exit, requires --socket
+    GroupLimits groupLimits;
     // The following 'const char*' pointers all point into static storage,
     // hence they never go out of scope.
     std::optional<const char*> slice;
     std::optional<const char*> workingDir;
     std::optional<const char*> description;
+    std::optional<const char*> argsFrom;
+    std::optional<const char*> group;
     std::vector<const char*> env;
     std::span<const char*> args;  // the element one past the end is guaranteed to be null
 };
 
 std::optional<CmdlineArgs> parseArgs(int argc, char* argv[]);
+
+// Parse the value of the corresponding option (also used for runapp.conf);
+// return std::nullopt if it is invalid.
+std::optional<OutputTarget> parseOutputTarget(std::string_view value);
+std::optional<LogRateLimit> parseLogRateLimit(std::string_view value);
+std::optional<int> parseLogLevel(std::string_view value);
+// "infinity" (i.e. no limit) is returned as the maximum value of the type.
+std::optional<std::uint64_t> parseByteSize(std::string_view value);
+std::optional<unsigned> parsePercentage(std::string_view value);
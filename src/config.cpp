@@ -0,0 +1,132 @@
+#include "config.h"
+#include "keyfile.h"
+#include "verbose.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+
+[[noreturn]] void throwInvalidValue(std::string_view key, std::string_view appName,
+                                    const std::string& value)
+{
+    throw std::runtime_error(std::format(
+            "invalid {}= value in group [{}] of runapp.conf: {}", key, appName, value));
+}
+
+
+template<class T>
+std::optional<T> parseNumber(const KeyFileGroup& keys, std::string_view key,
+                             std::string_view appName)
+{
+    const std::string* value = findKey(keys, key);
+    if (!value) {
+        return {};
+    }
+    T result{};
+    const char* end = value->data() + value->size();
+    auto [ptr, ec] = std::from_chars(value->data(), end, result);
+    if (ec != std::errc() || ptr != end) {
+        throwInvalidValue(key, appName, *value);
+    }
+    return result;
+}
+
+
+// Parse a value with the parser of the corresponding command line option.
+template<class T>
+std::optional<T> parseOptionValue(const KeyFileGroup& keys, std::string_view key,
+                                  std::string_view appName,
+                                  std::optional<T> (*parse)(std::string_view))
+{
+    const std::string* value = findKey(keys, key);
+    if (!value) {
+        return {};
+    }
+    std::optional<T> result = parse(*value);
+    if (!result) {
+        throwInvalidValue(key, appName, *value);
+    }
+    return result;
+}
+
+
+// Return the keys of the given group of runapp.conf (empty if there is no such group,
+// or no such file).
+KeyFileGroup loadConfigGroup(std::string_view groupName)
+{
+    const std::optional<fs::path> configHome = configHomeDir();
+    if (!configHome) {
+        return {};
+    }
+    const std::optional<std::string> content = readFile(*configHome / "runapp/runapp.conf");
+    if (!content) {
+        return {};
+    }
+    KeyFileGroup keys = parseKeyFileGroup(*content, groupName);
+    if (!keys.empty()) {
+        verbosePrintln("Applying defaults for {} from runapp.conf.", groupName);
+    }
+    return keys;
+}
+
+}
+
+
+std::optional<fs::path> configHomeDir()
+{
+    if (const char* configHome = std::getenv("XDG_CONFIG_HOME"); configHome && *configHome) {
+        return fs::path(configHome);
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return fs::path(home) / ".config";
+    }
+    return {};
+}
+
+
+std::optional<fs::path> stateHomeDir()
+{
+    if (const char* stateHome = std::getenv("XDG_STATE_HOME"); stateHome && *stateHome) {
+        return fs::path(stateHome);
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return fs::path(home) / ".local/state";
+    }
+    return {};
+}
+
+
+AppConfig loadAppConfig(std::string_view appName)
+{
+    const KeyFileGroup keys = loadConfigGroup(appName);
+
+    AppConfig config;
+    config.boostSec = parseNumber<unsigned>(keys, "Boost", appName);
+    config.output = parseOptionValue(keys, "Output", appName, parseOutputTarget);
+    config.logRateLimit = parseOptionValue(keys, "LogRateLimit", appName, parseLogRateLimit);
+    config.logLevelMax = parseOptionValue(keys, "LogLevelMax", appName, parseLogLevel);
+
+    return config;
+}
+
+
+GroupLimits loadGroupLimits(std::string_view groupName)
+{
+    const std::string name = std::format("Group {}", groupName);
+    const KeyFileGroup keys = loadConfigGroup(name);
+
+    GroupLimits limits;
+    limits.memoryMax = parseOptionValue(keys, "MemoryMax", name, parseByteSize);
+    limits.memoryHigh = parseOptionValue(keys, "MemoryHigh", name, parseByteSize);
+    limits.cpuQuotaPercent = parseOptionValue(keys, "CPUQuota", name, parsePercentage);
+    return limits;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cmdline.h"
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+// Per-app defaults for some options, read from $XDG_CONFIG_HOME/runapp/runapp.conf.
+// The file uses the desktop entry key file syntax, with one group per app (named like
+// the app, i.e. after its desktop entry ID or executable basename), e.g.:
+//
+//     [firefox]
+//     Boost=5
+//     Output=null
+//
+// Options given on the command line take precedence. Similarly, a group named
+// "Group NAME" holds the default limits for the app group NAME (--group), e.g.:
+//
+//     [Group myproject]
+//     MemoryMax=8G
+//     CPUQuota=400%
+struct AppConfig {
+    std::optional<unsigned> boostSec;
+    std::optional<OutputTarget> output;
+    std::optional<LogRateLimit> logRateLimit;
+    std::optional<int> logLevelMax;
+};
+
+// Return $XDG_CONFIG_HOME, or its default value, or std::nullopt if neither is available.
+std::optional<std::filesystem::path> configHomeDir();
+
+// Return $XDG_STATE_HOME, or its default value, or std::nullopt if neither is available.
+std::optional<std::filesystem::path> stateHomeDir();
+
+// Load the configuration for the given app; throw on invalid values.
+AppConfig loadAppConfig(std::string_view appName);
+
+// Load the limits configured for the given app group; throw on invalid values.
+GroupLimits loadGroupLimits(std::string_view groupName);
@@ -1,12 +1,11 @@
 #include "dbus.h"
+#include "output.h"
 #include "verbose.h"
 
 #include <cstdarg>
 #include <cstdint>
 #include <format>
-#include <iostream>
 #include <memory>
-#include <print>
 #include <stdexcept>
 #include <utility>
 
@@ -75,7 +74,12 @@ DBusMessage DBus::createMethodCall(
 
 DBusHandler DBus::createHandler(DBusMessageFunc&& handler)
 {
-    return DBusHandler(std::move(handler), this);
+    return DBusHandler(std::move(handler), {}, this);
+}
+
+DBusHandler DBus::createHandler(DBusMessageFunc&& handler, DBusErrorFunc&& errorHandler)
+{
+    return DBusHandler(std::move(handler), std::move(errorHandler), this);
 }
 
 void DBus::callAsync(const DBusMessage& message, const DBusHandler& handler)
@@ -104,6 +108,11 @@ void DBus::matchSignalAsync(
     h->d_slots.push_back(slot);
 }
 
+void DBus::setDeadline(std::optional<Clock::time_point> deadline) noexcept
+{
+    d_deadline = deadline;
+}
+
 void DBus::drive()
 {
     while (true) {
@@ -117,7 +126,16 @@ void DBus::drive()
         if (rc > 0) {
             return;
         }
-        check(sd_bus_wait(d_bus.get(), UINT64_MAX), "wait for D-Bus messages");
+
+        std::uint64_t timeoutUsec = UINT64_MAX;
+        if (d_deadline) {
+            const Clock::time_point now = Clock::now();
+            if (now >= *d_deadline) {
+                throw DBusTimeout();
+            }
+            timeoutUsec = std::chrono::ceil<std::chrono::microseconds>(*d_deadline - now).count();
+        }
+        check(sd_bus_wait(d_bus.get(), timeoutUsec), "wait for D-Bus messages");
     }
 }
 
@@ -131,10 +149,10 @@ void DBus::setException(std::exception_ptr e)
             std::rethrow_exception(e);
         }
         catch (const std::exception& exc) {
-            std::println(std::cerr, "Additional error: {}", exc.what());
+            fdPrintln(STDERR_FILENO, "Additional error: {}", exc.what());
         }
         catch (...) {
-            std::println(std::cerr, "Additional error (unknown)");
+            fdPrintln(STDERR_FILENO, "Additional error (unknown)");
         }
     }
 }
@@ -142,22 +160,29 @@ void DBus::setException(std::exception_ptr e)
 int DBus::handleMessage(sd_bus_message* m, void* userdata, sd_bus_error* retError)
 {
     auto* h = static_cast<DBusHandler::Impl*>(userdata);
-    return h->d_bus->handleMessageImpl(m, h->d_handler, retError);
+    return h->d_bus->handleMessageImpl(m, h->d_handler, h->d_errorHandler, retError);
 }
 
 int DBus::handleMessageImpl(sd_bus_message* m,
                             const DBusMessageFunc& handler,
+                            const DBusErrorFunc& errorHandler,
                             sd_bus_error* retError)
 {
-    if (sd_bus_message_is_method_error(m, nullptr)) {
+    const bool isError = sd_bus_message_is_method_error(m, nullptr);
+    if (isError && !errorHandler) {
         const sd_bus_error* err = sd_bus_message_get_error(m);
         setException(std::make_exception_ptr(std::runtime_error(err->message)));
         return sd_bus_error_copy(retError, err);
     }
 
     try {
-        DBusMessage msg{sd_bus_message_ref(m)};
-        handler(msg);
+        if (isError) {
+            errorHandler(*sd_bus_message_get_error(m));
+        }
+        else {
+            DBusMessage msg{sd_bus_message_ref(m)};
+            handler(msg);
+        }
         return 0;
     }
     catch (const std::exception& e) {
@@ -188,6 +213,28 @@ void DBusMessage::read(const char* types, ...)
     }
 }
 
+bool DBusMessage::tryRead(const char* types, ...)
+{
+    std::va_list args;
+    va_start(args, types);
+    int rc = sd_bus_message_readv(d_msg.get(), types, args);
+    va_end(args);
+    check(rc, "read D-Bus message field");
+    return rc != 0;
+}
+
+void DBusMessage::enterContainer(char type, const char* contents)
+{
+    check(sd_bus_message_enter_container(d_msg.get(), type, contents),
+          "read D-Bus message (enter container)");
+}
+
+void DBusMessage::exitContainer()
+{
+    check(sd_bus_message_exit_container(d_msg.get()),
+          "read D-Bus message (exit container)");
+}
+
 void DBusMessage::append(const char* types, ...)
 {
     std::va_list args;
@@ -209,8 +256,8 @@ void DBusMessage::closeContainer()
           "build D-Bus message (close container)");
 }
 
-DBusHandler::DBusHandler(DBusMessageFunc&& handler, DBus* bus)
-: d_impl(std::make_unique<Impl>(std::move(handler), bus))
+DBusHandler::DBusHandler(DBusMessageFunc&& handler, DBusErrorFunc&& errorHandler, DBus* bus)
+: d_impl(std::make_unique<Impl>(std::move(handler), std::move(errorHandler), bus))
 {
 }
 
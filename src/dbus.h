@@ -1,7 +1,12 @@
+#pragma once
+
+#include <chrono>
 #include <concepts>
 #include <exception>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vector>
 
 #include <systemd/sd-bus.h>
@@ -11,10 +16,20 @@ class DBusHandler;
 class DBusMessage;
 
 using DBusMessageFunc = std::function<void(DBusMessage&)>;
+using DBusErrorFunc = std::function<void(const sd_bus_error&)>;
+
+
+// Thrown by DBus::drive() when the deadline set via DBus::setDeadline() has passed.
+class DBusTimeout : public std::runtime_error {
+  public:
+    DBusTimeout() : std::runtime_error("timed out waiting for D-Bus messages") { }
+};
 
 
 class DBus {
   public:
+    using Clock = std::chrono::steady_clock;
+
     // Return connection to user systemd instance via the standard D-Bus broker.
     static DBus defaultUserBus();
 
@@ -30,6 +45,10 @@ class DBus {
 
     DBusHandler createHandler(DBusMessageFunc&& handler);
 
+    // Like the above, but method call errors are passed to errorHandler,
+    // rather than making drive() throw.
+    DBusHandler createHandler(DBusMessageFunc&& handler, DBusErrorFunc&& errorHandler);
+
     void callAsync(const DBusMessage& message, const DBusHandler& handler);
 
     void matchSignalAsync(
@@ -39,6 +58,10 @@ class DBus {
             const char* member,
             const DBusHandler& handler);
 
+    // Make drive() throw DBusTimeout once the given point in time has passed;
+    // std::nullopt (the default) means wait indefinitely.
+    void setDeadline(std::optional<Clock::time_point> deadline) noexcept;
+
     void drive();
 
     void driveUntil(const std::predicate auto& condition)
@@ -55,10 +78,14 @@ class DBus {
 
     static int handleMessage(sd_bus_message* m, void* userdata, sd_bus_error* retError);
 
-    int handleMessageImpl(sd_bus_message* m, const DBusMessageFunc& handler, sd_bus_error* retError);
+    int handleMessageImpl(sd_bus_message* m,
+                          const DBusMessageFunc& handler,
+                          const DBusErrorFunc& errorHandler,
+                          sd_bus_error* retError);
 
     std::unique_ptr<sd_bus, decltype(&sd_bus_flush_close_unref)> d_bus;
     std::exception_ptr d_exception;
+    std::optional<Clock::time_point> d_deadline;
 };
 
 
@@ -66,6 +93,13 @@ class DBusMessage {
   public:
     void read(const char* types, ...);
 
+    // Like read(), but return false rather than throwing at the end of the current
+    // container (e.g. after the last element of an array).
+    bool tryRead(const char* types, ...);
+
+    void enterContainer(char type, const char* contents);
+    void exitContainer();
+
     void append(const char* types, ...);
     void openContainer(char type, const char* contents);
     void closeContainer();
@@ -81,10 +115,11 @@ class DBusMessage {
 
 class DBusHandler {
   private:
-    DBusHandler(DBusMessageFunc&& handler, DBus* bus);
+    DBusHandler(DBusMessageFunc&& handler, DBusErrorFunc&& errorHandler, DBus* bus);
 
     struct Impl {
         DBusMessageFunc d_handler;
+        DBusErrorFunc d_errorHandler;
         DBus* d_bus;
         std::vector<sd_bus_slot*> d_slots;
 
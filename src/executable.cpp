@@ -0,0 +1,100 @@
+#include "executable.h"
+#include "fdguard.h"
+#include "verbose.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <ranges>
+#include <string>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+
+fs::path findExecutableInCwd(std::string_view filename)
+{
+    const fs::path path(filename);
+    std::error_code ec;
+    if (!canExecute(path, ec)) {
+        throw std::system_error(ec, std::string(filename));
+    }
+    return path;
+}
+
+
+fs::path findExecutableInSearchPath(std::string_view basename)
+{
+    const char* searchPath = std::getenv("PATH");
+
+    std::unique_ptr<char[]> searchPathBuf;
+    if (!searchPath) {
+        std::size_t len = confstr(_CS_PATH, nullptr, 0);
+        searchPathBuf = std::make_unique_for_overwrite<char[]>(len);
+        if (0 == confstr(_CS_PATH, searchPathBuf.get(), len)) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "failed to determine PATH system fallback value");
+        }
+        searchPath = searchPathBuf.get();
+        verbosePrintln("PATH is not defined, using system fallback value {}", searchPath);
+    }
+
+    for (const auto path : std::string_view(searchPath) | std::views::split(':')) {
+        const auto candidate = fs::path(std::string_view(path)) / basename;
+        std::error_code ec;
+        if (canExecute(candidate, ec)) {
+            return candidate;
+        }
+    }
+
+    throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory),
+                            std::string(basename));
+}
+
+} // namespace
+
+
+bool canExecute(const fs::path& path, std::error_code& ec)
+{
+    // Note that glibc includes an 'euidaccess()' function, but we don't use
+    // it because its implementation appears incomplete (does not check ACLs).
+
+    const int fd = open(path.c_str(), O_PATH);
+    if (fd == -1) {
+        ec = std::make_error_code(std::errc(errno));
+        return false;
+    }
+    FdGuard fdGuard{fd};
+
+    struct stat st;
+    if (faccessat(fd, "", X_OK, AT_EMPTY_PATH | AT_EACCESS) != 0 || fstat(fd, &st) != 0) {
+        ec = std::make_error_code(std::errc(errno));
+        return false;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(std::errc::permission_denied);
+        return false;
+    }
+
+    return true;
+}
+
+
+fs::path resolveExecutable(std::string_view arg0)
+{
+    const fs::path execPath = fs::absolute(
+            arg0.contains('/')
+            ? findExecutableInCwd(arg0)
+            : findExecutableInSearchPath(arg0));
+    verbosePrintln("Resolved executable {} to {}", arg0, execPath.native());
+    return execPath;
+}
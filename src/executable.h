@@ -0,0 +1,14 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+// Return whether the given path points to a regular file that is executable by the
+// current effective uid/gid; if not, set 'ec' to the reason.
+bool canExecute(const std::filesystem::path& path, std::error_code& ec);
+
+// Return the absolute path of the executable that execvp() would run for the given
+// argv[0], searching $PATH (or the system default search path, if it is not set)
+// unless it contains a slash; throw std::system_error if there is none.
+std::filesystem::path resolveExecutable(std::string_view arg0);
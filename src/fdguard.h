@@ -0,0 +1,22 @@
+#pragma once
+
+#include "output.h"
+
+#include <cerrno>
+#include <system_error>
+
+extern "C" {
+#include <unistd.h>
+}
+
+// Closes the given file descriptor when going out of scope; failing to do so is
+// reported, but not an error.
+struct FdGuard {
+    int fd;
+    ~FdGuard() {
+        if (close(fd) != 0) {
+            fdPrintln(STDERR_FILENO, "Failed to close file descriptor: {}",
+                      std::generic_category().message(errno));
+        }
+    }
+};
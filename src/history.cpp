@@ -0,0 +1,183 @@
+#include "history.h"
+#include "config.h"
+#include "fdguard.h"
+#include "verbose.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr char Magic[8] = {'r', 'u', 'n', 'a', 'p', 'p', 'H', '1'};
+constexpr std::size_t Capacity = 512;  // records; the file is 256 KiB plus the header
+
+// On-disk layout: a header followed by Capacity records, each padded to RecordSize bytes.
+// The file is only ever accessed while holding a flock() on it.
+constexpr std::size_t RecordSize = 512;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t next;   // index of the record to write next
+    std::uint32_t count;  // number of valid records
+};
+
+struct FileRecord {
+    std::int64_t timeUsec;
+    char app[120];
+    char path[384];  // NUL-terminated unless completely filled
+};
+
+static_assert(sizeof(FileHeader) <= RecordSize);
+static_assert(sizeof(FileRecord) == RecordSize);
+
+
+fs::path historyPath()
+{
+    const std::optional<fs::path> stateHome = stateHomeDir();
+    if (!stateHome) {
+        throw std::runtime_error("cannot determine XDG_STATE_HOME");
+    }
+    return *stateHome / "runapp/history";
+}
+
+
+off_t recordOffset(std::size_t index)
+{
+    return off_t(RecordSize) * (index + 1);
+}
+
+
+bool isValid(const FileHeader& header)
+{
+    return std::memcmp(header.magic, Magic, sizeof Magic) == 0
+           && header.next < Capacity && header.count <= Capacity;
+}
+
+
+// Lock the given file; the lock is released when it gets closed.
+void lockFile(int fd, int operation)
+{
+    while (flock(fd, operation) != 0) {
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "failed to lock history file");
+        }
+    }
+}
+
+
+void appendRecord(std::string_view app, const fs::path& path)
+{
+    if (path.native().size() >= sizeof(FileRecord::path)) {
+        verbosePrintln("Not recording launch in history: path too long.");
+        return;
+    }
+
+    FileRecord record{};
+    record.timeUsec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    app.copy(record.app, std::min(app.size(), sizeof record.app - 1));
+    path.native().copy(record.path, sizeof record.path - 1);
+
+    const fs::path filePath = historyPath();
+    fs::create_directories(filePath.parent_path());
+    const int fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), filePath.native());
+    }
+    const FdGuard fdGuard{fd};
+
+    lockFile(fd, LOCK_EX);
+
+    FileHeader header{};
+    if (pread(fd, &header, sizeof header, 0) != sizeof header || !isValid(header)) {
+        // New (or foreign) file: start afresh.
+        header = {};
+        std::memcpy(header.magic, Magic, sizeof Magic);
+    }
+
+    // No fsync(): losing the most recent records in a crash is harmless.
+    if (pwrite(fd, &record, sizeof record, recordOffset(header.next)) != sizeof record) {
+        throw std::system_error(errno, std::generic_category(), "failed to write history record");
+    }
+    header.next = (header.next + 1) % Capacity;
+    header.count = std::min<std::uint32_t>(header.count + 1, Capacity);
+    if (pwrite(fd, &header, sizeof header, 0) != sizeof header) {
+        throw std::system_error(errno, std::generic_category(), "failed to write history header");
+    }
+}
+
+}
+
+
+void recordLaunch(std::string_view app, const fs::path& path) noexcept
+try {
+    appendRecord(app, path);
+}
+catch (const std::exception& e) {
+    verbosePrintln("Failed to record launch in history: {}", e.what());
+}
+
+
+std::vector<LaunchRecord> readLaunchHistory()
+{
+    const fs::path filePath = historyPath();
+    const int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            return {};
+        }
+        throw std::system_error(errno, std::generic_category(), filePath.native());
+    }
+    const FdGuard fdGuard{fd};
+
+    lockFile(fd, LOCK_SH);
+
+    const std::size_t fileSize = RecordSize * (Capacity + 1);
+    const auto buf = std::make_unique_for_overwrite<char[]>(fileSize);
+    const ssize_t n = pread(fd, buf.get(), fileSize, 0);
+    if (n == -1) {
+        throw std::system_error(errno, std::generic_category(), filePath.native());
+    }
+
+    FileHeader header;
+    if (std::size_t(n) < sizeof header) {
+        return {};
+    }
+    std::memcpy(&header, buf.get(), sizeof header);
+    if (!isValid(header)) {
+        throw std::runtime_error(filePath.native() + " is not a runapp history file");
+    }
+
+    std::vector<LaunchRecord> records;
+    records.reserve(header.count);
+    const std::size_t first = header.count < Capacity ? 0 : header.next;
+    for (std::size_t i = 0; i < header.count; ++i) {
+        const std::size_t offset = recordOffset((first + i) % Capacity);
+        if (offset + RecordSize > std::size_t(n)) {
+            break;  // truncated file
+        }
+        FileRecord r;
+        std::memcpy(&r, buf.get() + offset, sizeof r);
+        records.push_back({
+            r.timeUsec,
+            std::string(r.app, strnlen(r.app, sizeof r.app)),
+            std::string(r.path, strnlen(r.path, sizeof r.path)),
+        });
+    }
+    return records;
+}
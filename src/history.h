@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Record of launches, kept in $XDG_STATE_HOME/runapp/history. The file is a
+// fixed-size ring buffer of fixed-size records, so appending to it is a single
+// pwrite() (plus updating the header), and it never needs to be trimmed.
+
+struct LaunchRecord {
+    std::int64_t timeUsec;  // CLOCK_REALTIME
+    std::string app;
+    std::filesystem::path path;  // resolved executable
+};
+
+// Append a record of the given launch; never throws (errors are reported verbosely),
+// as failing to record a launch must not fail the launch itself.
+void recordLaunch(std::string_view app, const std::filesystem::path& path) noexcept;
+
+// Return all recorded launches, oldest first; throw if the file exists but cannot be read.
+std::vector<LaunchRecord> readLaunchHistory();
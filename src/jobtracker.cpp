@@ -0,0 +1,110 @@
+#include "jobtracker.h"
+
+#include <utility>
+
+
+std::size_t JobList::add(DoneFunc&& onDone)
+{
+    d_entries.emplace_back(Job(), std::move(onDone));
+    ++d_pendingCount;
+    return d_entries.size() - 1;
+}
+
+
+void JobList::removeLast()
+{
+    if (!d_entries.back().job.isDone()) {
+        --d_pendingCount;
+    }
+    d_entries.pop_back();
+}
+
+
+void JobList::replied(std::size_t index, std::string_view path)
+{
+    Job& job = d_entries[index].job;
+    job.path = path;
+    job.replyTime = DBus::Clock::now();
+}
+
+
+void JobList::finish(std::size_t index, std::string_view result)
+{
+    Entry& entry = d_entries[index];
+    if (entry.job.isDone()) {
+        return;
+    }
+    entry.job.result = result.empty() ? "unknown" : result;
+    entry.job.removeTime = DBus::Clock::now();
+    --d_pendingCount;
+    if (entry.onDone) {
+        entry.onDone(entry.job);
+    }
+}
+
+
+void JobList::jobRemoved(std::string_view path, std::string_view result)
+{
+    // By index, as onDone may add further jobs.
+    for (std::size_t i = 0; i < d_entries.size(); ++i) {
+        const Job& job = d_entries[i].job;
+        if (!job.isDone() && !job.path.empty() && job.path == path) {
+            finish(i, result);
+            break;
+        }
+    }
+}
+
+
+void JobList::finishAll(std::string_view result)
+{
+    for (std::size_t i = 0; i < d_entries.size(); ++i) {
+        finish(i, result);
+    }
+}
+
+
+JobTracker::JobTracker(DBus& bus)
+    : d_bus(bus),
+      d_onJobRemoved(bus.createHandler([this](DBusMessage& msg) {
+          const char *sigPath{}, *sigResult{};
+          msg.read("uoss", nullptr, &sigPath, nullptr, &sigResult);
+          d_jobs.jobRemoved(sigPath, sigResult);
+      })),
+      d_onDisconnected(bus.createHandler([this](DBusMessage&) {
+          d_jobs.finishAll("disconnected");
+      }))
+{
+    bus.matchSignalAsync("org.freedesktop.systemd1",
+                         "/org/freedesktop/systemd1",
+                         "org.freedesktop.systemd1.Manager", "JobRemoved",
+                         d_onJobRemoved);
+    bus.matchSignalAsync(
+        "org.freedesktop.DBus.Local", nullptr, "org.freedesktop.DBus.Local",
+        "Disconnected", d_onDisconnected);
+}
+
+
+const JobTracker::Job& JobTracker::callAsync(const DBusMessage& req, DoneFunc&& onDone)
+{
+    const std::size_t index = d_jobs.add(std::move(onDone));
+    try {
+        d_bus.callAsync(req, d_replyHandlers.emplace_back(d_bus.createHandler(
+                [this, index](DBusMessage& resp) {
+                    const char *path{};
+                    resp.read("o", &path);
+                    d_jobs.replied(index, path);
+                },
+                [this, index](const sd_bus_error& err) {
+                    d_jobs.finish(index, err.message ? err.message : err.name);
+                })));
+    }
+    catch (...) {
+        if (d_replyHandlers.size() > index) {
+            d_replyHandlers.pop_back();
+        }
+        d_jobs.removeLast();
+        throw;
+    }
+    return d_jobs[index];
+}
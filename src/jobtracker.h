@@ -0,0 +1,91 @@
+#pragma once
+
+#include "dbus.h"
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// The bookkeeping of JobTracker apart from the connection: the jobs in flight, and
+// which of them a JobRemoved signal refers to.
+class JobList {
+  public:
+    struct Job {
+        std::string path;  // empty until the reply has been received
+        // Empty while the job is pending; then its result as per JobRemoved ("done",
+        // "failed", "canceled", ...), the error message if the method call failed,
+        // or "disconnected" if the connection was lost.
+        std::string result;
+        DBus::Clock::time_point replyTime, removeTime;
+
+        bool isDone() const noexcept { return !result.empty(); }
+    };
+
+    using DoneFunc = std::function<void(const Job&)>;
+
+    // Add a pending job, whose method call is about to be sent; return its index.
+    // Jobs stay put as more are added.
+    std::size_t add(DoneFunc&& onDone);
+
+    // Remove the job added last, if its method call could not be sent after all.
+    void removeLast();
+
+    const Job& operator[](std::size_t index) const noexcept { return d_entries[index].job; }
+
+    // Record the path of the given job, from the reply to its method call.
+    void replied(std::size_t index, std::string_view path);
+
+    // Set the result of the given job and call its onDone, unless it is done already.
+    void finish(std::size_t index, std::string_view result);
+
+    // Finish the pending job with the given path, if any; signals for other jobs
+    // (e.g. ones queued by other clients) are ignored.
+    void jobRemoved(std::string_view path, std::string_view result);
+
+    // Finish all pending jobs with the given result.
+    void finishAll(std::string_view result);
+
+    // Return the number of jobs whose result is not known yet.
+    std::size_t pendingCount() const noexcept { return d_pendingCount; }
+
+  private:
+    struct Entry {
+        Job job;
+        DoneFunc onDone;
+    };
+
+    std::deque<Entry> d_entries;  // a deque, so that jobs stay put as more are added
+    std::size_t d_pendingCount = 0;
+};
+
+
+// Tracks the systemd jobs queued by method calls like StartUnit and StopUnit (which
+// reply with the job's path) over the given connection, by matching the JobRemoved
+// signal, so that any number of jobs can be in flight on the connection at once.
+class JobTracker {
+  public:
+    using Job = JobList::Job;
+    using DoneFunc = JobList::DoneFunc;
+
+    explicit JobTracker(DBus& bus);
+
+    JobTracker(const JobTracker&) = delete;
+    JobTracker& operator=(const JobTracker&) = delete;
+
+    // Send the given method call, and track the job it queues; onDone (if any) is
+    // called from DBus::drive() once the job's result is known. The returned job
+    // stays valid for the lifetime of the tracker.
+    const Job& callAsync(const DBusMessage& req, DoneFunc&& onDone = {});
+
+    // Return the number of jobs whose result is not known yet.
+    std::size_t pendingCount() const noexcept { return d_jobs.pendingCount(); }
+
+  private:
+    DBus& d_bus;
+    JobList d_jobs;
+    std::deque<DBusHandler> d_replyHandlers;  // by job index
+    DBusHandler d_onJobRemoved;
+    DBusHandler d_onDisconnected;
+};
@@ -0,0 +1,97 @@
+#include "keyfile.h"
+
+#include <ranges>
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+std::string_view trim(std::string_view s)
+{
+    const std::size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\r") + 1 - begin);
+}
+
+
+std::string unescapeValue(std::string_view value)
+{
+    // https://specifications.freedesktop.org/desktop-entry-spec/latest/value-types.html
+    std::string result;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] != '\\' || i + 1 == value.size()) {
+            result += value[i];
+            continue;
+        }
+        switch (value[++i]) {
+        case 's': result += ' '; break;
+        case 'n': result += '\n'; break;
+        case 't': result += '\t'; break;
+        case 'r': result += '\r'; break;
+        case '\\': result += '\\'; break;
+        default:
+            result += '\\';
+            result += value[i];
+        }
+    }
+    return result;
+}
+
+}
+
+
+std::optional<std::string> readFile(const std::filesystem::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return {};
+    }
+    std::string content;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof buf)) > 0) {
+        content.append(buf, n);
+    }
+    close(fd);
+    if (n != 0) {
+        return {};
+    }
+    return content;
+}
+
+
+KeyFileGroup parseKeyFileGroup(std::string_view content, std::string_view groupName)
+{
+    KeyFileGroup keys;
+    bool inGroup = false;
+    for (const auto lineRange : content | std::views::split('\n')) {
+        const std::string_view line = trim(std::string_view(lineRange));
+        if (line.empty() || line.starts_with('#')) {
+            continue;
+        }
+        if (line.starts_with('[') && line.ends_with(']')) {
+            inGroup = line.substr(1, line.size() - 2) == groupName;
+            continue;
+        }
+        const std::size_t eq = line.find('=');
+        if (!inGroup || eq == std::string_view::npos) {
+            continue;
+        }
+        keys.try_emplace(std::string(trim(line.substr(0, eq))),
+                         unescapeValue(trim(line.substr(eq + 1))));
+    }
+    return keys;
+}
+
+
+const std::string* findKey(const KeyFileGroup& keys, std::string_view key)
+{
+    const auto it = keys.find(key);
+    return it != keys.end() ? &it->second : nullptr;
+}
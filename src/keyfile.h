@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Reading of files in the "key file" format of desktop entries, which runapp also
+// uses for its own configuration file:
+// https://specifications.freedesktop.org/desktop-entry-spec/latest/basic-format.html
+
+// Keys and (unescaped) values of one group of a key file.
+using KeyFileGroup = std::map<std::string, std::string, std::less<>>;
+
+// Return the contents of the given file, or std::nullopt if it cannot be read.
+std::optional<std::string> readFile(const std::filesystem::path& path);
+
+// Return the keys of the given group of a key file (empty if there is no such group).
+KeyFileGroup parseKeyFileGroup(std::string_view content, std::string_view groupName);
+
+// Return the value of the given key, or nullptr if absent.
+const std::string* findKey(const KeyFileGroup& keys, std::string_view key);
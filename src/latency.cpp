@@ -0,0 +1,516 @@
+#include "latency.h"
+#include "config.h"
+#include "output.h"
+#include "verbose.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr const char* PhaseNames[LaunchPhaseCount] = {
+    "connect", "prepare", "reply", "job", "total"
+};
+
+// See latencyBucketIndex().
+constexpr unsigned SubBucketBits = 3;
+constexpr unsigned SubBuckets = 1u << SubBucketBits;
+constexpr std::size_t BucketCount = 26 * SubBuckets;
+
+// Distinct (app, mode) combinations. Once all slots are in use, the least recently
+// used one is evicted for a new combination. The file is sparse, so unused slots
+// cost no disk space.
+constexpr std::size_t SlotCount = 256;
+constexpr std::uint64_t Magic = 0x324c544150504e52;  // "RNPPATL2", layout version 2
+constexpr std::uint64_t MagicVersionMask = 0xff00000000000000;  // the version digit
+
+// Slot states
+constexpr std::uint32_t SlotEmpty = 0;
+constexpr std::uint32_t SlotClaimed = 1;  // key being written
+constexpr std::uint32_t SlotReady = 2;
+
+// The file layout. All counters are only ever accessed via std::atomic_ref.
+struct Histogram {
+    std::uint64_t count;
+    std::uint64_t sumUsec;
+    std::uint64_t maxUsec;
+    std::uint64_t buckets[BucketCount];
+};
+
+struct Slot {
+    std::uint32_t state;
+    char mode[12];  // the key: written before the state becomes SlotReady
+    char app[112];
+    std::uint64_t lastUse;  // value of LatencyFile::useClock when last recorded to
+    Histogram phases[LaunchPhaseCount];
+};
+
+}
+
+struct LatencyFile {
+    std::uint64_t magic;
+    std::uint64_t useClock;   // incremented for each recorded launch
+    std::uint64_t evictions;  // number of slots taken over for another key
+    std::uint64_t reserved[5];
+    Slot slots[SlotCount];
+};
+
+
+std::size_t latencyBucketIndex(std::uint64_t usec)
+{
+    if (usec < SubBuckets) {
+        return usec;
+    }
+    const unsigned exponent = std::bit_width(usec) - 1;  // >= SubBucketBits
+    const std::size_t subBucket = (usec >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+    return std::min((exponent - SubBucketBits + 1) * SubBuckets + subBucket, BucketCount - 1);
+}
+
+
+std::uint64_t latencyBucketUpperBound(std::size_t index)
+{
+    if (index < SubBuckets) {
+        return index;
+    }
+    const unsigned shift = index / SubBuckets - 1;
+    const std::uint64_t lower = (SubBuckets + index % SubBuckets) << shift;
+    return lower + (std::uint64_t(1) << shift) - 1;
+}
+
+
+namespace {
+
+fs::path latencyFilePath()
+{
+    const std::optional<fs::path> stateHome = stateHomeDir();
+    if (!stateHome) {
+        throw std::runtime_error("cannot determine XDG_STATE_HOME");
+    }
+    return *stateHome / "runapp/latency";
+}
+
+
+// Map the file open as 'fd' (which is closed), extending it to the size of a
+// LatencyFile first if need be; concurrent invocations may race to extend a new file,
+// but they all extend it to the same size (and the new part reads as zeroes). Unless
+// the file is in use already, claim it by setting its magic number. Return the
+// magic number it had, 0 for a new file.
+std::uint64_t mapLatencyFile(int fd, const fs::path& path, LatencyFile*& file)
+{
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0
+                    && (std::size_t(st.st_size) >= sizeof(LatencyFile)
+                        || ftruncate(fd, sizeof(LatencyFile)) == 0);
+    void* map = ok ? mmap(nullptr, sizeof(LatencyFile), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0)
+                   : MAP_FAILED;
+    const int savedErrno = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::system_error(savedErrno, std::generic_category(), path.native());
+    }
+    file = static_cast<LatencyFile*>(map);
+
+    std::uint64_t magic = 0;
+    std::atomic_ref(file->magic).compare_exchange_strong(magic, Magic);
+    return magic;
+}
+
+
+// Replace the file at the given path with a new one (by renaming, so that invocations
+// that still have the old one mapped are not affected), and return it open.
+int replaceLatencyFile(const fs::path& path)
+{
+    const fs::path newPath = std::format("{}.{}", path.native(), getpid());
+    const int fd = open(newPath.c_str(), O_RDWR | O_CLOEXEC | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), newPath.native());
+    }
+    if (rename(newPath.c_str(), path.c_str()) != 0) {
+        const int savedErrno = errno;
+        close(fd);
+        unlink(newPath.c_str());
+        throw std::system_error(savedErrno, std::generic_category(), path.native());
+    }
+    return fd;
+}
+
+}
+
+
+// Memory-mapped latency file.
+class LatencyMap {
+  public:
+    // Map the file, creating it if requested; if it does not exist (and is not to be
+    // created), file() returns nullptr. A file left by an older version of runapp,
+    // with a different layout, is treated as missing; if it is to be created, it is
+    // replaced with a new one.
+    explicit LatencyMap(bool create)
+    {
+        const fs::path path = latencyFilePath();
+        if (create) {
+            fs::create_directories(path.parent_path());
+        }
+        const int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+        if (fd == -1) {
+            if (errno == ENOENT && !create) {
+                return;
+            }
+            throw std::system_error(errno, std::generic_category(), path.native());
+        }
+
+        const std::uint64_t magic = mapLatencyFile(fd, path, d_file);
+        if (magic == 0 || magic == Magic) {
+            return;
+        }
+        munmap(d_file, sizeof(LatencyFile));
+        d_file = nullptr;
+        if ((magic & ~MagicVersionMask) != (Magic & ~MagicVersionMask)) {
+            throw std::runtime_error(path.native() + " is not a runapp latency file");
+        }
+        if (create) {
+            verbosePrintln("Replacing {}, which has the layout of another runapp version.",
+                           path.native());
+            mapLatencyFile(replaceLatencyFile(path), path, d_file);
+        }
+    }
+
+    ~LatencyMap()
+    {
+        if (d_file) {
+            munmap(d_file, sizeof(LatencyFile));
+        }
+    }
+
+    LatencyMap(const LatencyMap&) = delete;
+    LatencyMap& operator=(const LatencyMap&) = delete;
+
+    LatencyFile* file() const noexcept { return d_file; }
+
+  private:
+    LatencyFile* d_file{};
+};
+
+
+namespace {
+
+bool keyMatches(const Slot& slot, std::string_view app, std::string_view mode)
+{
+    return std::string_view(slot.app, strnlen(slot.app, sizeof slot.app)) == app
+           && std::string_view(slot.mode, strnlen(slot.mode, sizeof slot.mode)) == mode;
+}
+
+
+void writeKey(Slot& slot, std::string_view app, std::string_view mode)
+{
+    std::memset(slot.app, 0, sizeof slot.app);
+    std::memset(slot.mode, 0, sizeof slot.mode);
+    app.copy(slot.app, app.size());
+    mode.copy(slot.mode, mode.size());
+}
+
+
+// Take over the least recently used slot for the given key, resetting its histograms.
+// A concurrent invocation that has just looked up the slot's previous key may still
+// add its launch to the new key; that is an acceptable loss of precision for a rare
+// event. Return nullptr if another invocation is taking over the same slot.
+Slot* evictSlot(LatencyFile& file, std::string_view app, std::string_view mode)
+{
+    constexpr auto relaxed = std::memory_order_relaxed;
+
+    Slot* victim = nullptr;
+    std::uint64_t oldestUse = UINT64_MAX;
+    for (Slot& slot : file.slots) {
+        const std::uint64_t lastUse = std::atomic_ref(slot.lastUse).load(relaxed);
+        if (std::atomic_ref(slot.state).load(std::memory_order_acquire) == SlotReady
+            && lastUse < oldestUse)
+        {
+            victim = &slot;
+            oldestUse = lastUse;
+        }
+    }
+
+    std::uint32_t expected = SlotReady;
+    if (!victim || !std::atomic_ref(victim->state).compare_exchange_strong(
+                           expected, SlotClaimed, std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+
+    for (Histogram& hist : victim->phases) {
+        std::atomic_ref(hist.count).store(0, relaxed);
+        std::atomic_ref(hist.sumUsec).store(0, relaxed);
+        std::atomic_ref(hist.maxUsec).store(0, relaxed);
+        for (std::uint64_t& bucket : hist.buckets) {
+            std::atomic_ref(bucket).store(0, relaxed);
+        }
+    }
+    writeKey(*victim, app, mode);
+    std::atomic_ref(file.evictions).fetch_add(1, relaxed);
+    std::atomic_ref(victim->state).store(SlotReady, std::memory_order_release);
+    return victim;
+}
+
+
+// Find the slot for the given key (an open-addressing hash table, with slots claimed
+// by compare-and-swap), or claim a new one for it, evicting the least recently used
+// one if the table is full. Return nullptr if that fails.
+Slot* findSlot(LatencyFile& file, std::string_view app, std::string_view mode)
+{
+    app = app.substr(0, sizeof(Slot::app) - 1);
+    mode = mode.substr(0, sizeof(Slot::mode) - 1);
+
+    std::uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+    for (const std::string_view part : {app, std::string_view("\0", 1), mode}) {
+        for (const char c : part) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+        }
+    }
+
+    for (std::size_t i = 0; i < SlotCount; ++i) {
+        Slot& slot = file.slots[(hash + i) % SlotCount];
+        std::atomic_ref state(slot.state);
+
+        std::uint32_t current = state.load(std::memory_order_acquire);
+        if (current == SlotEmpty
+            && state.compare_exchange_strong(current, SlotClaimed, std::memory_order_acquire))
+        {
+            writeKey(slot, app, mode);
+            state.store(SlotReady, std::memory_order_release);
+            return &slot;
+        }
+
+        // Another invocation is writing the key; it will be done very soon (unless it
+        // crashed in the meantime, in which case the slot remains unusable).
+        for (int spins = 0; current == SlotClaimed && spins < 1000; ++spins) {
+            sched_yield();
+            current = state.load(std::memory_order_acquire);
+        }
+        if (current == SlotReady && keyMatches(slot, app, mode)) {
+            return &slot;
+        }
+    }
+    return evictSlot(file, app, mode);
+}
+
+
+void addToHistogram(Histogram& hist, std::uint64_t usec)
+{
+    constexpr auto relaxed = std::memory_order_relaxed;
+    std::atomic_ref(hist.count).fetch_add(1, relaxed);
+    std::atomic_ref(hist.sumUsec).fetch_add(usec, relaxed);
+    std::atomic_ref(hist.buckets[latencyBucketIndex(usec)]).fetch_add(1, relaxed);
+
+    std::atomic_ref max(hist.maxUsec);
+    std::uint64_t currentMax = max.load(relaxed);
+    while (usec > currentMax && !max.compare_exchange_weak(currentMax, usec, relaxed)) {
+    }
+}
+
+
+struct PhaseStats {
+    std::uint64_t count, meanUsec, p50Usec, p90Usec, p99Usec, maxUsec;
+};
+
+
+PhaseStats summarize(Histogram& hist)
+{
+    // Take a snapshot of the buckets; concurrent updates may make it slightly
+    // inconsistent with the count, so derive the latter from the former.
+    constexpr auto relaxed = std::memory_order_relaxed;
+    std::uint64_t buckets[BucketCount];
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < BucketCount; ++i) {
+        buckets[i] = std::atomic_ref(hist.buckets[i]).load(relaxed);
+        count += buckets[i];
+    }
+
+    PhaseStats stats{};
+    stats.count = count;
+    if (count == 0) {
+        return stats;
+    }
+    stats.maxUsec = std::atomic_ref(hist.maxUsec).load(relaxed);
+    stats.meanUsec = std::atomic_ref(hist.sumUsec).load(relaxed)
+                     / std::max<std::uint64_t>(std::atomic_ref(hist.count).load(relaxed), 1);
+
+    const auto percentile = [&](unsigned p) {
+        const std::uint64_t rank = (count * p + 99) / 100;  // 1-based, rounded up
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(latencyBucketUpperBound(i), stats.maxUsec);
+            }
+        }
+        return stats.maxUsec;
+    };
+    stats.p50Usec = percentile(50);
+    stats.p90Usec = percentile(90);
+    stats.p99Usec = percentile(99);
+    return stats;
+}
+
+
+void appendJsonString(std::string& out, std::string_view s)
+{
+    out += '"';
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            std::format_to(std::back_inserter(out), "\\u{:04x}", c);
+        }
+        else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+}
+
+
+LatencyRecorder::LatencyRecorder() noexcept
+{
+    try {
+        d_map = std::make_unique<LatencyMap>(true);
+    }
+    catch (const std::exception& e) {
+        verbosePrintln("Failed to record launch latency: {}", e.what());
+    }
+}
+
+
+LatencyRecorder::~LatencyRecorder() = default;
+
+
+void LatencyRecorder::record(std::string_view app, std::string_view mode,
+                             const LaunchPhaseDurations& durations) const noexcept
+try {
+    if (!d_map) {
+        return;
+    }
+    LatencyFile& file = *d_map->file();
+    Slot* slot = findSlot(file, app, mode);
+    if (!slot) {
+        verbosePrintln("Not recording launch latency: lost the race for a slot in the latency file.");
+        return;
+    }
+    std::atomic_ref(slot->lastUse).store(
+            std::atomic_ref(file.useClock).fetch_add(1, std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+    for (std::size_t i = 0; i < LaunchPhaseCount; ++i) {
+        addToHistogram(slot->phases[i], std::max<std::int64_t>(durations[i].count(), 0));
+    }
+}
+catch (const std::exception& e) {
+    verbosePrintln("Failed to record launch latency: {}", e.what());
+}
+
+
+void printLatencyReport(bool asJson)
+{
+    const LatencyMap map(false);
+
+    std::vector<Slot*> slots;
+    std::uint64_t evictions = 0;
+    if (LatencyFile* file = map.file()) {
+        for (Slot& slot : file->slots) {
+            if (std::atomic_ref(slot.state).load(std::memory_order_acquire) == SlotReady) {
+                slots.push_back(&slot);
+            }
+        }
+        evictions = std::atomic_ref(file->evictions).load(std::memory_order_relaxed);
+    }
+    std::ranges::sort(slots, [](const Slot* a, const Slot* b) {
+        const int cmp = std::strncmp(a->app, b->app, sizeof a->app);
+        return cmp != 0 ? cmp < 0 : std::strncmp(a->mode, b->mode, sizeof a->mode) < 0;
+    });
+
+    std::string out;
+    const auto appendTo = std::back_inserter(out);
+
+    if (asJson) {
+        std::format_to(appendTo, "{{\"slots\":{},\"slots_used\":{},\"evictions\":{},\"launches\":[",
+                       SlotCount, slots.size(), evictions);
+        for (Slot* slot : slots) {
+            if (slot != slots.front()) {
+                out += ',';
+            }
+            out += "{\"app\":";
+            appendJsonString(out, std::string_view(slot->app, strnlen(slot->app, sizeof slot->app)));
+            out += ",\"mode\":";
+            appendJsonString(out, std::string_view(slot->mode, strnlen(slot->mode, sizeof slot->mode)));
+            out += ",\"phases\":{";
+            for (std::size_t i = 0; i < LaunchPhaseCount; ++i) {
+                const PhaseStats s = summarize(slot->phases[i]);
+                std::format_to(appendTo,
+                               "{}\"{}\":{{\"count\":{},\"mean_us\":{},\"p50_us\":{},"
+                               "\"p90_us\":{},\"p99_us\":{},\"max_us\":{}}}",
+                               i == 0 ? "" : ",", PhaseNames[i], s.count, s.meanUsec,
+                               s.p50Usec, s.p90Usec, s.p99Usec, s.maxUsec);
+            }
+            out += "}}";
+        }
+        out += "]}\n";
+    }
+    else if (slots.empty()) {
+        out = "No launches recorded.\n";
+    }
+    else {
+        const auto appendRow = [&](const auto&... columns) {
+            std::format_to(appendTo, "{:<32} {:<8} {:<8} {:>7} {:>9} {:>9} {:>9} {:>9} {:>9}\n",
+                           columns...);
+        };
+        appendRow("APP", "MODE", "PHASE", "COUNT", "MEAN(ms)", "P50(ms)", "P90(ms)", "P99(ms)",
+                  "MAX(ms)");
+        for (Slot* slot : slots) {
+            const std::string_view app(slot->app, strnlen(slot->app, sizeof slot->app));
+            const std::string_view mode(slot->mode, strnlen(slot->mode, sizeof slot->mode));
+            for (std::size_t i = 0; i < LaunchPhaseCount; ++i) {
+                const PhaseStats s = summarize(slot->phases[i]);
+                const auto ms = [](std::uint64_t usec) { return std::format("{:.2f}", usec / 1e3); };
+                const std::string mean = ms(s.meanUsec), p50 = ms(s.p50Usec), p90 = ms(s.p90Usec),
+                                  p99 = ms(s.p99Usec), max = ms(s.maxUsec);
+                appendRow(app, mode, PhaseNames[i], s.count, mean, p50, p90, p99, max);
+            }
+        }
+        if (slots.size() == SlotCount || evictions > 0) {
+            std::format_to(appendTo,
+                           "\nAll {} slots are in use; {} least recently used app/mode "
+                           "combinations have been evicted so far.\n",
+                           SlotCount, evictions);
+        }
+    }
+
+    if (!writeAll(STDOUT_FILENO, out)) {
+        throw std::system_error(errno, std::generic_category(), "failed to write report");
+    }
+}
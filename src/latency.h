@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// Launch latency statistics, aggregated across runapp invocations in a memory-mapped
+// file ($XDG_STATE_HOME/runapp/latency) holding one set of histograms per app and
+// mode. Invocations update it concurrently with atomic operations only: no locks,
+// no fsync().
+
+enum class LaunchPhase {
+    Connect,  // connecting to systemd
+    Prepare,  // building the request (and installing the template unit, if needed)
+    Reply,    // waiting for the reply to the start request
+    Job,      // waiting for the start job to complete
+    Total,    // from runapp's start to the unit having been started
+};
+
+inline constexpr std::size_t LaunchPhaseCount = 5;
+
+using LaunchPhaseDurations = std::array<std::chrono::microseconds, LaunchPhaseCount>;
+
+class LatencyMap;
+
+// Records a launch in the statistics. The file is mapped on construction, so that the
+// system calls involved can overlap with waiting for systemd, and recording the launch
+// once it has completed only takes a few atomic operations.
+class LatencyRecorder {
+  public:
+    // Map the file, creating it if need be; never throws (errors are reported verbosely,
+    // and make record() do nothing).
+    LatencyRecorder() noexcept;
+    ~LatencyRecorder();
+
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    // Add the given launch to the statistics; never throws.
+    void record(std::string_view app, std::string_view mode,
+                const LaunchPhaseDurations& durations) const noexcept;
+
+  private:
+    std::unique_ptr<LatencyMap> d_map;
+};
+
+// Print percentiles for each app, mode and phase, as a table or as JSON.
+void printLatencyReport(bool asJson);
+
+// Histogram buckets are log-linear, as in HdrHistogram: values (in microseconds) below
+// 8 get a bucket each, and every further power of two is split into 8 buckets, giving
+// a relative precision of 1/8. The last bucket also takes all larger values (from
+// about 4.5 minutes). Return the index of the bucket for the given value.
+std::size_t latencyBucketIndex(std::uint64_t usec);
+
+// Return the largest value that falls into the given bucket.
+std::uint64_t latencyBucketUpperBound(std::size_t index);
@@ -1,34 +1,55 @@
+#include "arglist.h"
+#include "autostart.h"
+#include "auxunits.h"
 #include "cmdline.h"
+#include "config.h"
 #include "dbus.h"
+#include "executable.h"
+#include "fdguard.h"
+#include "history.h"
+#include "jobtracker.h"
+#include "keyfile.h"
+#include "latency.h"
+#include "output.h"
+#include "prewarm.h"
+#include "template.h"
+#include "unitname.h"
 #include "verbose.h"
 
 #include <algorithm>
 #include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <csignal>
 #include <cstring>
 #include <exception>
 #include <filesystem>
 #include <format>
-#include <ios>
-#include <iostream>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <optional>
-#include <print>
-#include <ranges>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <vector>
 
 extern "C" {
 #include <fcntl.h>
 #include <sys/pidfd.h>
 #include <sys/random.h>
 #include <sys/stat.h>
+#include <syslog.h>
 #include <unistd.h>
 }
 
+#include <systemd/sd-journal.h>
+
 
 namespace {
 
@@ -42,17 +63,65 @@ int throwSystemError(std::string_view operation, int code)
 }
 
 
-struct FdGuard {
-    int fd;
-    ~FdGuard() {
-        if (close(fd) != 0) {
-            std::println(std::cerr, "Failed to close file descriptor: {}",
-                         std::generic_category().message(errno));
+struct FileRemover {
+    fs::path path;
+    ~FileRemover() {
+        if (!path.empty() && unlink(path.c_str()) != 0 && errno != ENOENT) {
+            fdPrintln(STDERR_FILENO, "Failed to remove {}: {}",
+                      path.native(), std::generic_category().message(errno));
         }
     }
 };
 
 
+const char* runtimeDir()
+{
+    const char* rtDir = std::getenv("XDG_RUNTIME_DIR");
+    if (!rtDir) {
+        throw std::runtime_error("XDG_RUNTIME_DIR is not set");
+    }
+    return rtDir;
+}
+
+
+void writeFile(const fs::path& path, std::string_view content, mode_t mode)
+{
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), path.native());
+    }
+    FdGuard fdGuard{fd};
+    if (!writeAll(fd, content)) {
+        throw std::system_error(errno, std::generic_category(), path.native());
+    }
+}
+
+
+// Write the given content to the given file (atomically, via a temporary file),
+// unless it already has exactly that content. Return whether the file was written.
+bool writeFileIfChanged(const fs::path& path, std::string_view content)
+{
+    if (const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); fd != -1) {
+        FdGuard fdGuard{fd};
+        std::string existing;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof buf)) > 0) {
+            existing.append(buf, n);
+        }
+        if (n == 0 && existing == content) {
+            return false;
+        }
+    }
+
+    fs::create_directories(path.parent_path());
+    const fs::path tmpPath = std::format("{}.{}.tmp", path.native(), getpid());
+    writeFile(tmpPath, content, 0644);
+    fs::rename(tmpPath, path);
+    return true;
+}
+
+
 std::optional<std::string> envDesktopEntryID()
 {
     const char* envValue = std::getenv("DESKTOP_ENTRY_ID");
@@ -72,79 +141,232 @@ std::optional<std::string> envDesktopEntryID()
 }
 
 
-bool canExecute(const fs::path& path, std::error_code& ec)
+// Slices for --background and --session, as recommended by
+// https://systemd.io/DESKTOP_ENVIRONMENTS/#pre-defined-systemd-units, with resource
+// settings that protect the latency of apps and of the session's core components.
+// CPU and IO weights only compete among siblings, so they go on the parent slice,
+// which is a sibling of app.slice (where both default to 100). Memory protection
+// only takes effect as far as all ancestors grant it, so MemoryLow= goes on both.
+struct SliceTier {
+    const char* slice;
+    const char* description;
+    const char* parentSlice;
+    std::uint64_t cpuWeight;  // of the parent slice
+    std::uint64_t ioWeight;   // of the parent slice
+    std::optional<std::uint64_t> memoryLow;
+};
+
+constexpr SliceTier BackgroundTier{
+    "background-graphical.slice", "User Graphical Background Applications",
+    "background.slice", 20, 20, {}};
+constexpr SliceTier SessionTier{
+    "session-graphical.slice", "User Graphical Session Components",
+    "session.slice", 200, 200, 256 << 20};
+
+
+const SliceTier* sliceTier(const CmdlineArgs& args)
 {
-    // Check that the given path points to a regular file that is executable
-    // by the current effective uid/gid.
-    // Note that glibc includes an 'euidaccess()' function, but we don't use
-    // it because its implementation appears incomplete (does not check ACLs).
+    return args.isBackground ? &BackgroundTier : args.isSession ? &SessionTier : nullptr;
+}
 
-    const int fd = open(path.c_str(), O_PATH);
-    if (fd == -1) {
-        ec = std::make_error_code(std::errc(errno));
-        return false;
-    }
-    FdGuard fdGuard{fd};
 
-    struct stat st;
-    if (faccessat(fd, "", X_OK, AT_EMPTY_PATH | AT_EACCESS) != 0 || fstat(fd, &st) != 0) {
-        ec = std::make_error_code(std::errc(errno));
-        return false;
+std::string unitSlice(const CmdlineArgs& args)
+{
+    const SliceTier* tier = sliceTier(args);
+    const std::string_view slice = tier ? tier->slice : args.slice.value_or("app-graphical.slice");
+    if (!args.group) {
+        return std::string(slice);
     }
+    // A child of the slice that the unit would be in otherwise.
+    return childSliceName(slice, "group_" + escapeUnitNameComponent(*args.group));
+}
 
-    if (!S_ISREG(st.st_mode)) {
-        ec = std::make_error_code(std::errc::permission_denied);
-        return false;
-    }
 
-    return true;
+// Create the given slice as a transient unit, unless it exists already (having been
+// created before, or having a unit file), with properties added by appendProperties;
+// call onCreated if it did not exist. The request is only queued: systemd handles the
+// requests on a connection in order, so the slice will exist by the time it gets to a
+// subsequent request for a unit in that slice. The returned handler must be kept alive
+// until the reply has been received.
+template<class AppendProperties, class OnCreated>
+DBusHandler ensureSliceAsync(DBus& bus, const std::string& slice, const char* description,
+                             AppendProperties appendProperties, OnCreated onCreated)
+{
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "StartTransientUnit");
+    req.append("ss", slice.c_str(), "fail");
+    req.openContainer('a', "(sv)");
+    req.append("(sv)", "Description", "s", description);
+    appendProperties(req);
+    req.closeContainer();
+    req.append("a(sa(sv))", nullptr);
+
+    DBusHandler handler = bus.createHandler(
+            [slice, onCreated](DBusMessage&) {
+                verbosePrintln("Created {}.", slice);
+                onCreated();
+            },
+            [slice](const sd_bus_error& err) {
+                if (!sd_bus_error_has_name(&err, "org.freedesktop.systemd1.UnitExists")) {
+                    verbosePrintln("Failed to create {}: {}",
+                                   slice, err.message ? err.message : err.name);
+                }
+            });
+    bus.callAsync(req, handler);
+    return handler;
 }
 
 
-fs::path findExecutableInCwd(std::string_view filename)
+// Create the slice of the given tier, see above. If it did not exist yet, also apply
+// the tier's settings to the parent slice, at runtime only (i.e. until the user's
+// systemd instance stops): the parent is shared with anything else that the session
+// places there, and its unit file (if any) remains in charge otherwise.
+DBusHandler ensureSliceAsync(DBus& bus, const SliceTier& tier)
 {
-    const fs::path path(filename);
-    std::error_code ec;
-    if (!canExecute(path, ec)) {
-        throw std::system_error(ec, std::string(filename));
-    }
-    return path;
+    // Owned by the handler of the slice creation, which calls it.
+    const auto onParentResponse = std::make_shared<std::optional<DBusHandler>>();
+
+    const auto appendProperties = [&tier](DBusMessage& req) {
+        if (tier.memoryLow) {
+            req.append("(sv)", "MemoryLow", "t", *tier.memoryLow);
+        }
+    };
+
+    const auto onCreated = [&bus, &tier, onParentResponse] {
+        DBusMessage req = bus.createMethodCall(
+                "org.freedesktop.systemd1",
+                "/org/freedesktop/systemd1",
+                "org.freedesktop.systemd1.Manager",
+                "SetUnitProperties");
+        req.append("sb", tier.parentSlice, 1);  // runtime = true
+        req.openContainer('a', "(sv)");
+        req.append("(sv)", "CPUWeight", "t", tier.cpuWeight);
+        req.append("(sv)", "IOWeight", "t", tier.ioWeight);
+        if (tier.memoryLow) {
+            req.append("(sv)", "MemoryLow", "t", *tier.memoryLow);
+        }
+        req.closeContainer();
+
+        *onParentResponse = bus.createHandler(
+                [&tier](DBusMessage&) { verbosePrintln("Set up {}.", tier.parentSlice); },
+                [&tier](const sd_bus_error& err) {
+                    verbosePrintln("Failed to set up {}: {}",
+                                   tier.parentSlice, err.message ? err.message : err.name);
+                });
+        bus.callAsync(req, **onParentResponse);
+    };
+
+    return ensureSliceAsync(bus, tier.slice, tier.description, appendProperties, onCreated);
 }
 
 
-fs::path findExecutableInSearchPath(std::string_view basename)
+// Append the limits that are given (UINT64_MAX meaning "infinity", i.e. no limit, as
+// for systemd); the others are left as they are.
+void appendGroupLimits(DBusMessage& req, const GroupLimits& limits)
 {
-    const char* searchPath = std::getenv("PATH");
+    if (limits.memoryMax) {
+        req.append("(sv)", "MemoryMax", "t", *limits.memoryMax);
+    }
+    if (limits.memoryHigh) {
+        req.append("(sv)", "MemoryHigh", "t", *limits.memoryHigh);
+    }
+    if (limits.cpuQuotaPercent) {
+        // CPUQuota=100% corresponds to one second of CPU time per second.
+        req.append("(sv)", "CPUQuotaPerSecUSec", "t",
+                   *limits.cpuQuotaPercent == UINT_MAX
+                           ? UINT64_MAX : std::uint64_t(*limits.cpuQuotaPercent) * 10'000);
+    }
+}
 
-    std::unique_ptr<char[]> searchPathBuf;
-    if (!searchPath) {
-        std::size_t len = confstr(_CS_PATH, nullptr, 0);
-        searchPathBuf = std::make_unique_for_overwrite<char[]>(len);
-        if (0 == confstr(_CS_PATH, searchPathBuf.get(), len)) {
-            throwSystemError("determine PATH system fallback value", errno);
-        }
-        searchPath = searchPathBuf.get();
-        verbosePrintln("PATH is not defined, using system fallback value {}", searchPath);
+
+// Create the slice of the --group, see above, and if any limits are given, also queue
+// a request to apply them, in case the slice existed already: this costs no round trip
+// either. The returned handlers must be kept alive until the replies have been received.
+std::vector<DBusHandler> ensureGroupSliceAsync(DBus& bus, const CmdlineArgs& args)
+{
+    const std::string slice = unitSlice(args);
+    const std::string description = std::format("App Group {}", *args.group);
+
+    std::vector<DBusHandler> handlers;
+    handlers.push_back(ensureSliceAsync(bus, slice, description.c_str(), [&](DBusMessage& req) {
+        appendGroupLimits(req, args.groupLimits);
+    }, [] {}));
+    if (args.groupLimits.empty()) {
+        return handlers;
     }
 
-    for (const auto path : std::string_view(searchPath) | std::views::split(':')) {
-        const auto candidate = fs::path(std::string_view(path)) / basename;
-        std::error_code ec;
-        if (canExecute(candidate, ec)) {
-            return candidate;
-        }
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "SetUnitProperties");
+    req.append("sb", slice.c_str(), 1);  // runtime = true
+    req.openContainer('a', "(sv)");
+    appendGroupLimits(req, args.groupLimits);
+    req.closeContainer();
+
+    handlers.push_back(bus.createHandler(
+            [](DBusMessage&) {},
+            [slice](const sd_bus_error& err) {
+                verbosePrintln("Failed to set limits of {}: {}",
+                               slice, err.message ? err.message : err.name);
+            }));
+    bus.callAsync(req, handlers.back());
+    return handlers;
+}
+
+
+// The cgroup (relative to that of the unit) in which a command run with --delegate starts.
+constexpr char DelegateSubgroup[] = "main";
+
+// The environment variable that tells a command run with --delegate the directory of
+// its delegated subtree in the cgroup file system.
+constexpr char DelegatedCgroupVar[] = "RUNAPP_DELEGATED_CGROUP";
+
+
+// CPUWeight= and IOWeight= for the duration of a --boost window (the default is 100).
+constexpr std::uint64_t BoostWeight = 1000;
+
+
+bool isBoosted(const CmdlineArgs& args)
+{
+    return args.boostSec.value_or(0) > 0;
+}
+
+
+// Throw if the command line is too long for the ExecStart= of a transient service (see
+// UnitFileMaxLineLength), rather than have systemd fail to load the unit after
+// accepting it; the D-Bus message itself could hold 64 times as much.
+void checkExecLineLength(const fs::path& execPath, const CmdlineArgs& args,
+                         const ArgList* extraArgs)
+{
+    std::size_t length = std::strlen("ExecStart=@") + execWordLength(execPath.native());
+    const auto add = [&length](const char* arg) { length += execWordLength(arg); };
+    std::ranges::for_each(args.args, add);
+    if (extraArgs) {
+        extraArgs->forEach(add);
     }
 
-    throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory),
-                            std::string(basename));
+    if (length > UnitFileMaxLineLength) {
+        throw std::runtime_error(std::format(
+                "argument list too long for a systemd unit "
+                "({} bytes when quoted; the maximum is {} bytes)",
+                length, UnitFileMaxLineLength));
+    }
 }
 
 
-DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* description,
-                              const CmdlineArgs& args)
+// Append the properties of the unit described below to req, as an array of
+// struct { key:string, value:variant }. 'execPath' is args.args[0] as resolved by
+// resolveExecutable() (unused for a scope).
+void appendUnitProperties(DBusMessage& req, const char* description, const CmdlineArgs& args,
+                          const fs::path& execPath, const ArgList* extraArgs, pid_t scopePid)
 {
-    // Call user systemd via D-Bus. If args.isScope, the call will be approximately
-    // equivalent to:
+    // Call user systemd via D-Bus (see buildStartRequest()). If args.isScope, the
+    // call will be approximately equivalent to:
     //
     //   systemd-run --user --unit=${unitName} --description=${description}
     //     --quiet --slice=${slice} --collect
@@ -162,21 +384,46 @@ DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* descr
     // our own PID in PIDFDs=, and we'll then ultimately execute the target program
     // directly.
 
-    DBusMessage req = bus.createMethodCall(
-            "org.freedesktop.systemd1",
-            "/org/freedesktop/systemd1",
-            "org.freedesktop.systemd1.Manager",
-            "StartTransientUnit");
-    req.append("ss", unitName, "fail"); // 'name' and 'mode' args
-
-    // Begin unit properties ('properties' arg)
     req.openContainer('a', "(sv)");  // array of struct { key:string, value:variant }
     req.append("(sv)", "Description", "s", description);
     req.append("(sv)", "CollectMode", "s", "inactive-or-failed");
-    req.append("(sv)", "Slice", "s", args.slice.value_or("app-graphical.slice"));
+    req.append("(sv)", "Slice", "s", unitSlice(args).c_str());
+
+    if (args.idleExitSec) {
+        // Stopped along with the proxy in front of it; see buildStartRequest().
+        req.append("(sv)", "StopWhenUnneeded", "b", 1);
+    }
+
+    if (isBoosted(args)) {
+        req.append("(sv)", "CPUWeight", "t", BoostWeight);
+        req.append("(sv)", "IOWeight", "t", BoostWeight);
+    }
+
+    if (args.delegateControllers) {
+        if (args.delegateControllers->empty()) {
+            req.append("(sv)", "Delegate", "b", 1);
+        }
+        else {
+            // Implies Delegate=yes.
+            req.openContainer('r', "sv");
+            req.append("s", "DelegateControllers");
+            req.openContainer('v', "as");
+            req.openContainer('a', "s");
+            for (const std::string& controller : *args.delegateControllers) {
+                req.append("s", controller.c_str());
+            }
+            req.closeContainer();
+            req.closeContainer();
+            req.closeContainer();
+        }
+        if (!args.isScope) {
+            // For a scope, see moveIntoDelegatedSubgroup().
+            req.append("(sv)", "DelegateSubgroup", "s", DelegateSubgroup);
+        }
+    }
 
     if (args.isScope) {
-        const int pfd = pidfd_open(getpid(), 0);
+        const int pfd = pidfd_open(scopePid, 0);
         if (pfd == -1) {
             throwSystemError("get pidfd", errno);
         }
@@ -187,12 +434,7 @@ DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* descr
         req.append("(sv)", "Type", "s", "exec");
         req.append("(sv)", "ExitType", "s", "cgroup");
 
-        const std::string_view arg0 = args.args[0];
-        const fs::path execPath = fs::absolute(
-                arg0.contains('/')
-                ? findExecutableInCwd(arg0)
-                : findExecutableInSearchPath(arg0));
-        verbosePrintln("Resolved executable {} to {}", arg0, execPath.native());
+        checkExecLineLength(execPath, args, extraArgs);
 
         // Begin ExecStart= property
         req.openContainer('r', "sv");  // struct { key:string, value:variant }
@@ -206,6 +448,10 @@ DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* descr
         for (const char* arg : args.args) {
             req.append("s", arg);
         }
+        if (extraArgs) {
+            // Appended straight from the (possibly memory-mapped) argument list.
+            extraArgs->forEach([&req](const char* arg) { req.append("s", arg); });
+        }
         req.closeContainer();  // end argv
         req.append("b", 0);    // ignoreFailure = false
         req.closeContainer();  // end array element struct
@@ -231,18 +477,188 @@ DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* descr
             req.closeContainer();  // end variant
             req.closeContainer();  // end struct
         }
+
+        if (args.output) {
+            switch (args.output->kind) {
+            case OutputTarget::Kind::Journal:
+                req.append("(sv)", "StandardOutput", "s", "journal");
+                break;
+            case OutputTarget::Kind::Null:
+                req.append("(sv)", "StandardOutput", "s", "null");
+                break;
+            case OutputTarget::Kind::File:
+                req.append("(sv)", "StandardOutputFileToTruncate", "s",
+                           args.output->path.c_str());
+                break;
+            }
+            req.append("(sv)", "StandardError", "s", "inherit");  // i.e. same as stdout
+        }
+
+        if (args.logRateLimit) {
+            req.append("(sv)", "LogRateLimitIntervalUSec", "t",
+                       std::uint64_t(args.logRateLimit->intervalSec) * 1'000'000);
+            req.append("(sv)", "LogRateLimitBurst", "u", args.logRateLimit->burst);
+        }
+
+        if (args.logLevelMax) {
+            req.append("(sv)", "LogLevelMax", "i", *args.logLevelMax);
+        }
+    }
+
+    req.closeContainer();
+}
+
+
+// Append an ExecStart= property running the given command line (argv[0] being the
+// executable), as a struct { key:string, value:variant }.
+void appendExecStart(DBusMessage& req, const std::vector<std::string>& command,
+                     bool ignoreFailure)
+{
+    req.openContainer('r', "sv");
+    req.append("s", "ExecStart");
+    req.openContainer('v', "a(sasb)");
+    req.openContainer('a', "(sasb)");
+    req.openContainer('r', "sasb");
+    req.append("s", command.front().c_str());
+    req.openContainer('a', "s");
+    for (const std::string& arg : command) {
+        req.append("s", arg.c_str());
+    }
+    req.closeContainer();
+    req.append("b", int(ignoreFailure));
+    req.closeContainer();
+    req.closeContainer();
+    req.closeContainer();
+    req.closeContainer();
+}
+
+
+// Return the path of systemd-socket-proxyd, which is not on $PATH.
+fs::path findSocketProxyd()
+{
+    std::error_code ec;
+    for (const char* path : {"/usr/lib/systemd/systemd-socket-proxyd",
+                             "/lib/systemd/systemd-socket-proxyd"})
+    {
+        if (canExecute(path, ec)) {
+            return path;
+        }
+    }
+    throw std::runtime_error(std::format("cannot find systemd-socket-proxyd: {}", ec.message()));
+}
+
+
+// Append the properties of a socket unit listening on the given address, as an array
+// of struct { key:string, value:variant }.
+void appendSocketProperties(DBusMessage& req, const char* description, const CmdlineArgs& args,
+                            const char* address)
+{
+    req.openContainer('a', "(sv)");
+    req.append("(sv)", "Description", "s", description);
+    req.append("(sv)", "CollectMode", "s", "inactive-or-failed");
+    req.append("(sv)", "Slice", "s", unitSlice(args).c_str());
+    req.append("(sv)", "Listen", "a(ss)", 1, "ListenStream", address);
+    if (address[0] == '/') {
+        req.append("(sv)", "SocketMode", "u", 0600);
+        req.append("(sv)", "RemoveOnStop", "b", 1);
     }
+    req.closeContainer();
+}
+
 
+// Append the properties of the proxy service for the given service with --idle-exit
+// (see buildStartRequest()), as an array of struct { key:string, value:variant }.
+void appendProxyProperties(DBusMessage& req, const char* description, const CmdlineArgs& args,
+                           const char* serviceName, const SocketUnits& units)
+{
+    const std::string proxyDescription = std::format("{} (socket proxy)", description);
+
+    req.openContainer('a', "(sv)");
+    req.append("(sv)", "Description", "s", proxyDescription.c_str());
+    req.append("(sv)", "CollectMode", "s", "inactive-or-failed");
+    req.append("(sv)", "Slice", "s", unitSlice(args).c_str());
+    for (const char* dependency : {"Requires", "After"}) {
+        req.append("(sv)", dependency, "as", 2, units.backendName.c_str(), serviceName);
+    }
+    appendExecStart(req, units.proxyCommand, false);
     req.closeContainer();
-    // End 'properties' arg
+}
+
+
+DBusMessage buildStartRequest(DBus& bus, const char* unitName, const char* description,
+                              const CmdlineArgs& args, const fs::path& execPath,
+                              const ArgList* extraArgs = nullptr, pid_t scopePid = getpid())
+{
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "StartTransientUnit");
+
+    if (!args.socket) {
+        req.append("ss", unitName, "fail"); // 'name' and 'mode' args
+        appendUnitProperties(req, description, args, execPath, extraArgs, scopePid);  // 'properties' arg
+        req.append("a(sa(sv))", nullptr); // 'aux' arg is unused
+        return req;
+    }
 
-    req.append("a(sa(sv))", nullptr); // 'aux' arg is unused
+    // With --socket, we start a socket unit instead, roughly like:
+    //
+    //   systemd-run --user --unit=${unitName} ... --socket-property=ListenStream=${socket}
+    //
+    // which passes the service (that systemd starts on the first connection) in the
+    // 'aux' arg.
+    //
+    // With --idle-exit, the service's socket listens on a private Unix socket instead,
+    // and the socket on ${socket} starts a proxy service, which requires the service,
+    // and exits once idle, whereupon systemd stops the service as well, as it is
+    // StopWhenUnneeded= (see systemd-socket-proxyd(8)). The units referenced by the
+    // proxy service need to come first in 'aux'.
+    const SocketUnits units = describeSocketUnits(
+            unitName, args.idleExitSec.value_or(0), runtimeDir(),
+            args.idleExitSec ? findSocketProxyd() : fs::path());
+    req.append("ss", units.listenerName.c_str(), "fail"); // 'name' and 'mode' args
+    appendSocketProperties(req, description, args, args.socket->c_str());  // 'properties' arg
+
+    // Begin 'aux' arg
+    req.openContainer('a', "(sa(sv))");  // array of struct { name:string, properties:array }
+    if (args.idleExitSec) {
+        req.openContainer('r', "sa(sv)");
+        req.append("s", units.backendName.c_str());
+        appendSocketProperties(req, description, args, units.backendPath.c_str());
+        req.closeContainer();
+    }
+    req.openContainer('r', "sa(sv)");
+    req.append("s", unitName);
+    appendUnitProperties(req, description, args, execPath, extraArgs, scopePid);
+    req.closeContainer();
+    if (args.idleExitSec) {
+        req.openContainer('r', "sa(sv)");
+        req.append("s", units.proxyName.c_str());
+        appendProxyProperties(req, description, args, unitName, units);
+        req.closeContainer();
+    }
+    req.closeContainer();
+    // End 'aux' arg
 
     return req;
 }
 
 
-std::string buildUnitName(const std::string& appName, const CmdlineArgs& args)
+std::string buildUnitName(std::string_view unitPrefix, bool isScope)
+{
+    std::uint64_t randU64;
+    if (getentropy(&randU64, sizeof randU64) != 0) {
+        throwSystemError("get random bytes", errno);
+    }
+
+    return instanceUnitName(unitPrefix, randU64, isScope);
+}
+
+
+// Return the prefix of the names of the units for the given app, to which
+// buildUnitName() appends a random string and the unit type suffix.
+std::string appUnitPrefix(const std::string& appName)
 {
     // https://systemd.io/DESKTOP_ENVIRONMENTS/#xdg-standardization-for-applications
     // states recommendations that we follow here.
@@ -253,110 +669,139 @@ std::string buildUnitName(const std::string& appName, const CmdlineArgs& args)
         unitPrefix += '-';
     }
     unitPrefix += appName;
-
-    // https://www.freedesktop.org/software/systemd/man/latest/systemd.unit.html#Description says:
-    //   The "unit name prefix" must consist of one or more valid characters
-    //   (ASCII letters, digits, ":", "-", "_", ".", and "\").
-    const auto isInvalidChar = [](char c) {
-        return !(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9')
-                 || std::strchr(":-_.\\", c) != nullptr);
-    };
-    std::replace_if(unitPrefix.begin(), unitPrefix.end(), isInvalidChar, '_');
+    unitPrefix = sanitizeUnitName(unitPrefix);
 
     // https://www.freedesktop.org/software/systemd/man/latest/systemd.unit.html#Description says:
     //   The total length of the unit name including the suffix must not exceed 255 characters.
-    // We are about to append a random string and a suffix (".service" or ".scope"),
-    // so account for that.
+    // buildUnitName() appends a random string and a suffix (".service" or ".scope"),
+    // and in template mode templateUnitPrefix() appends a hash before those; so
+    // account for all of that.
     const std::size_t maxPrefixLen = 220;
     if (unitPrefix.size() > maxPrefixLen) {
         unitPrefix.resize(maxPrefixLen);
     }
 
-    std::uint64_t randU64;
-    if (getentropy(&randU64, sizeof randU64) != 0) {
-        throwSystemError("get random bytes", errno);
-    }
-
-    if (args.isScope) {
-        return std::format("{}-{:016x}.scope", unitPrefix, randU64);
-    }
-    else {
-        return std::format("{}@{:016x}.service", unitPrefix, randU64);
-    }
+    return unitPrefix;
 }
 
 
-void startUnit(const char* unitName, const char* description, const CmdlineArgs& args)
+std::string buildUnitName(const std::string& appName, const CmdlineArgs& args)
 {
-    DBus bus = DBus::systemdUserBus();
+    return buildUnitName(appUnitPrefix(appName), args.isScope);
+}
 
-    const DBusMessage req = buildStartRequest(bus, unitName, description, args);
 
-    // Set up D-Bus signal handlers so we get to know about the result of
-    // starting the job.
+// Template mode (see template.h). The template unit name is derived from the app
+// unit prefix and a hash of the drop-in (see templateUnitPrefix()), and instances
+// are named like services otherwise. Note that WorkingDirectory= does not support
+// environment variable expansion, so it cannot be set per instance; -d/--dir is
+// therefore rejected in template mode (see parseArgs()).
 
-    std::string jobPath, jobResult;
+std::string buildTemplateDropIn(const char* description, const CmdlineArgs& args,
+                                const fs::path& execPath)
+{
+    // $RUNAPP_ARGS, given as a separate word, is split into the remaining arguments
+    // (see writeInstanceEnvFile()).
+    std::string dropIn = std::format(
+            "# Generated by runapp; any changes will be overwritten.\n"
+            "[Unit]\n"
+            "Description={}\n"
+            "\n"
+            "[Service]\n"
+            "Slice={}\n"
+            "ExecStart=@{} {} $RUNAPP_ARGS\n",
+            escapeUnitValue(description),
+            unitSlice(args),
+            quoteExecWord(execPath.native()),
+            quoteExecWord(args.args[0]));
+
+    if (isBoosted(args)) {
+        dropIn += std::format("CPUWeight={0}\nIOWeight={0}\n", BoostWeight);
+    }
 
-    auto onJobRemoved = bus.createHandler([&jobPath, &jobResult](DBusMessage& msg) {
-        const char *sigPath{}, *sigResult{};
-        msg.read("uoss", nullptr, &sigPath, nullptr, &sigResult);
-        if (jobPath == sigPath) {
-            jobResult = sigResult;
+    if (args.delegateControllers) {
+        std::string controllers;
+        for (const std::string& controller : *args.delegateControllers) {
+            controllers += (controllers.empty() ? "" : " ") + controller;
         }
-    });
-    bus.matchSignalAsync("org.freedesktop.systemd1",
-                         "/org/freedesktop/systemd1",
-                         "org.freedesktop.systemd1.Manager", "JobRemoved",
-                         onJobRemoved);
+        dropIn += std::format("Delegate={}\nDelegateSubgroup={}\n",
+                              controllers.empty() ? "yes" : controllers, DelegateSubgroup);
+    }
 
-    auto onDisconnected = bus.createHandler([&jobResult](DBusMessage&) {
-        if (jobResult.empty()) {
-            jobResult = "disconnected";
-        }
-    });
-    bus.matchSignalAsync(
-        "org.freedesktop.DBus.Local", nullptr, "org.freedesktop.DBus.Local",
-        "Disconnected", onDisconnected);
+    if (args.output) {
+        const OutputTarget& output = *args.output;
+        dropIn += std::format(
+                "StandardOutput={}\nStandardError=inherit\n",
+                output.kind == OutputTarget::Kind::Journal ? "journal"
+                : output.kind == OutputTarget::Kind::Null ? "null"
+                : "truncate:" + escapeUnitValue(output.path));
+    }
 
-    if (args.isScope) {
-        verbosePrintln("Starting {}; will execute: {}.", description, args.args);
+    if (args.logRateLimit) {
+        dropIn += std::format("LogRateLimitIntervalSec={}\nLogRateLimitBurst={}\n",
+                              args.logRateLimit->intervalSec, args.logRateLimit->burst);
     }
-    else {
-        verbosePrintln("Launching {}: {}.", description, args.args);
+
+    if (args.logLevelMax) {
+        dropIn += std::format("LogLevelMax={}\n", *args.logLevelMax);
     }
 
-    auto onStartResponse = bus.createHandler([&jobPath](DBusMessage& resp) {
-        const char *path{};
-        resp.read("o", &path);
-        jobPath = path;
-    });
-    bus.callAsync(req, onStartResponse);
+    return dropIn;
+}
 
-    bus.driveUntil([&] { return !jobResult.empty(); });
 
-    if (jobResult == "failed") {
-        throw std::runtime_error("startup failure");
-    }
-    if (jobResult != "done") {
-        throw std::runtime_error(jobResult);
+void installTemplate(DBus& bus, const std::string& templateName, const std::string& dropIn)
+{
+    const fs::path unitDir = fs::path(runtimeDir()) / "systemd/user";
+
+    // Drop-ins apply in the order of their file names, so name ours to sort before
+    // those of 'systemctl set-property' (like 50-CPUWeight.conf, as written by
+    // scheduleBoostEndAsync()), which must win even after a daemon reload.
+    bool changed = writeFileIfChanged(unitDir / templateName, buildTemplateUnit());
+    changed |= writeFileIfChanged(unitDir / (templateName + ".d") / "10-runapp.conf", dropIn);
+    if (!changed) {
+        return;
     }
+
+    verbosePrintln("Installed template unit {}; reloading systemd.", templateName);
+
+    const DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "Reload");
+
+    bool done = false;
+    auto onResponse = bus.createHandler([&done](DBusMessage&) { done = true; });
+    bus.callAsync(req, onResponse);
+    bus.driveUntil([&] { return done; });
 }
 
 
-void executeCommand(const CmdlineArgs& args)
+fs::path instanceEnvFilePath(const char* unitName)
 {
-    if (args.workingDir) {
-        if (chdir(*args.workingDir) != 0) {
-            throwSystemError("chdir", errno);
-        }
-    }
-    for (const char* env : args.env) {
-        if (putenv(const_cast<char*>(env)) != 0) {
-            throwSystemError("putenv", errno);
-        }
-    }
-    execvp(args.args[0], const_cast<char**>(args.args.data()));
-    throwSystemError("execute program", errno);
+    return fs::path(runtimeDir()) / "runapp" / std::format("{}.env", unitName);
+}
+
+
+void writeInstanceEnvFile(const char* unitName, const CmdlineArgs& args)
+{
+    const std::string content = buildInstanceEnvFile(args.args.subspan(1), args.env);
+    const fs::path path = instanceEnvFilePath(unitName);
+    fs::create_directories(path.parent_path());
+    writeFile(path, content, 0600);
+}
+
+
+DBusMessage buildTemplateStartRequest(DBus& bus, const char* unitName)
+{
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "StartUnit");
+    req.append("ss", unitName, "fail"); // 'name' and 'mode' args
+    return req;
 }
 
 
@@ -391,31 +836,895 @@ try {
     bus.driveUntil([&] { return done; });
 }
 catch (const std::exception& e) {
-    std::println(std::cerr, "Failed to notify user of error via org.freedesktop.Notifications: {}",
-                 e.what());
+    fdPrintln(STDERR_FILENO, "Failed to notify user of error via org.freedesktop.Notifications: {}",
+              e.what());
 }
 
-} // namespace
-
 
-int main(int argc, char* argv[])
+void reportError(const std::string& errmsg, const std::optional<std::string>& desktopID)
 {
-    std::ios::sync_with_stdio(false);  // We only use C++ streams.
-    std::cout << std::unitbuf;  // Enable flush after output for cout (like cerr).
-
-    CmdlineArgs args;
-    if (auto a = parseArgs(argc, argv)) {
-        args = std::move(*a);
-    }
-    else {
-        return 2;
+    fdPrintln(STDERR_FILENO, "{}", errmsg);
+    if (!isatty(STDIN_FILENO)) {
+        verbosePrintln("Notifying user of error via org.freedesktop.Notifications.");
+        notifyErrorFreedesktop(errmsg, desktopID);
     }
+}
 
-    if (args.isHelp) {
-        return 0;
-    }
 
-    g_verbose = args.isVerbose;
+// Call the given method and wait for the reply; errors are merely reported (verbosely).
+void callIgnoringErrors(DBus& bus, const DBusMessage& req, std::string_view operation)
+{
+    bool done = false;
+    auto onResponse = bus.createHandler(
+            [&done](DBusMessage&) { done = true; },
+            [&done, operation](const sd_bus_error& err) {
+                verbosePrintln("Failed to {}: {}", operation, err.message ? err.message : err.name);
+                done = true;
+            });
+    bus.callAsync(req, onResponse);
+    bus.driveUntil([&] { return done; });
+}
+
+
+// Return the directory of the cgroup of the given process in the cgroup file system.
+fs::path cgroupDirOf(pid_t pid)
+{
+    const std::optional<std::string> content = readFile(std::format("/proc/{}/cgroup", pid));
+    if (!content || !content->starts_with("0::/")) {
+        throw std::runtime_error("cannot determine cgroup (no unified cgroup hierarchy?)");
+    }
+    return fs::path("/sys/fs/cgroup") / std::string_view(*content).substr(4, content->find('\n') - 4);
+}
+
+
+// With --delegate in scope mode, move the given process (for ourselves, the command
+// that we are about to execute) from the root of the scope's cgroup 'delegatedDir' into
+// a subgroup, so that the command finds itself in the same place as with
+// DelegateSubgroup= in a service, and the root remains free of processes, so that
+// controllers can be enabled for its children.
+void moveIntoDelegatedSubgroup(const fs::path& delegatedDir, pid_t pid)
+{
+    const fs::path subgroupDir = delegatedDir / DelegateSubgroup;
+    if (mkdir(subgroupDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), subgroupDir.native());
+    }
+    writeFile(subgroupDir / "cgroup.procs", std::to_string(pid), 0644);
+    verbosePrintln("Moved process {} into {}.", pid, subgroupDir.native());
+}
+
+
+// Like moveIntoDelegatedSubgroup(), for a command that -x/--deadline-exec executed
+// directly, once its scope exists: by then, it may have started further processes
+// there, all of which need to move. We ourselves may be in the scope as well (see
+// adoptDirectlyExecuted()), but will be gone soon.
+void moveAdoptedIntoDelegatedSubgroup(pid_t child)
+{
+    const fs::path delegatedDir = cgroupDirOf(child);
+    const std::optional<std::string> procs = readFile(delegatedDir / "cgroup.procs");
+    if (!procs) {
+        throw std::system_error(errno, std::generic_category(), delegatedDir.native());
+    }
+    const char* p = procs->data();
+    const char* const end = p + procs->size();
+    while (p < end) {
+        pid_t pid{};
+        const auto [next, ec] = std::from_chars(p, end, pid);
+        if (ec != std::errc()) {
+            break;
+        }
+        if (pid != getpid()) {
+            moveIntoDelegatedSubgroup(delegatedDir, pid);
+        }
+        p = next + 1;  // skip the newline
+    }
+}
+
+
+// Redirect our stdout and stderr as requested via --output, before executing the
+// command ourselves. (A scope, unlike a service, simply inherits them from us.)
+void redirectOutput(const OutputTarget& output, const char* arg0)
+{
+    int fd = -1;
+    switch (output.kind) {
+    case OutputTarget::Kind::Journal:
+        fd = sd_journal_stream_fd(fs::path(arg0).filename().c_str(), LOG_INFO, 0);
+        if (fd < 0) {
+            throwSystemError("connect to the journal", -fd);
+        }
+        break;
+    case OutputTarget::Kind::Null:
+        fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        break;
+    case OutputTarget::Kind::File:
+        fd = open(output.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        break;
+    }
+    if (fd == -1) {
+        throwSystemError("open output file", errno);
+    }
+    if (fd != STDOUT_FILENO && dup2(fd, STDOUT_FILENO) == -1) {
+        throwSystemError("redirect stdout", errno);
+    }
+    if (fd != STDERR_FILENO && dup2(fd, STDERR_FILENO) == -1) {
+        throwSystemError("redirect stderr", errno);
+    }
+    if (fd > STDERR_FILENO) {
+        close(fd);
+    }
+}
+
+
+// Execute the command in place of this process. 'beforeExec' (if any) is called
+// once the working directory and environment are those of the command.
+void executeCommand(const CmdlineArgs& args, const std::function<void()>& beforeExec = {})
+{
+    if (args.workingDir) {
+        if (chdir(*args.workingDir) != 0) {
+            throwSystemError("chdir", errno);
+        }
+    }
+    for (const char* env : args.env) {
+        if (putenv(const_cast<char*>(env)) != 0) {
+            throwSystemError("putenv", errno);
+        }
+    }
+    if (beforeExec) {
+        beforeExec();
+    }
+
+    // Redirect the output as the very last step, so that our own errors up to here
+    // still go to our stderr; keep a copy of it for reporting a failure of execvp().
+    int origStderr = -1;
+    const auto restoreStderr = [&origStderr] {
+        if (origStderr != -1) {
+            dup2(origStderr, STDERR_FILENO);
+            close(origStderr);
+        }
+    };
+    if (args.output) {
+        origStderr = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+        if (origStderr == -1) {
+            throwSystemError("duplicate stderr", errno);
+        }
+        try {
+            redirectOutput(*args.output, args.args[0]);
+        }
+        catch (const std::exception&) {
+            restoreStderr();
+            throw;
+        }
+    }
+
+    execvp(args.args[0], const_cast<char**>(args.args.data()));
+    const int savedErrno = errno;
+    restoreStderr();
+    throwSystemError("execute program", savedErrno);
+}
+
+
+// How long to wait for systemd to adopt a directly executed app (see below); this is
+// the default D-Bus method call timeout.
+constexpr std::chrono::seconds AdoptionTimeout{25};
+
+
+// Called once the deadline has passed and the command has been executed directly
+// by the process 'pid'. Wait for systemd to catch up with our original request,
+// then make sure that the app ends up in a scope and does not run twice.
+void adoptDirectlyExecuted(DBus& bus, const char* unitName, const char* description,
+                           const CmdlineArgs& args, pid_t pid,
+                           JobTracker& jobs, const JobTracker::Job* startJob)
+{
+    if (startJob) {
+        bus.driveUntil([&] { return !startJob->path.empty() || startJob->isDone(); });
+        if (!args.isScope && !startJob->isDone()) {
+            // Normally, systemd gets this before it gets round to running the job.
+            const DBusMessage cancelReq = bus.createMethodCall(
+                    "org.freedesktop.systemd1",
+                    startJob->path.c_str(),
+                    "org.freedesktop.systemd1.Job",
+                    "Cancel");
+            callIgnoringErrors(bus, cancelReq, "cancel start job");
+        }
+        bus.driveUntil([&] { return startJob->isDone(); });
+    }
+    const bool isStarted = startJob && startJob->result == "done";
+
+    if (args.isScope && isStarted) {
+        // The scope contains our own process; move the app in there as well.
+        verbosePrintln("Moving directly executed {} into {}.", args.args[0], unitName);
+        DBusMessage attachReq = bus.createMethodCall(
+                "org.freedesktop.systemd1",
+                "/org/freedesktop/systemd1",
+                "org.freedesktop.systemd1.Manager",
+                "AttachProcessesToUnit");
+        attachReq.append("ssau", unitName, "", 1, std::uint32_t(pid));
+        callIgnoringErrors(bus, attachReq, "attach process to scope");
+        return;
+    }
+
+    if (isStarted) {
+        // The service got started after all; stop it, so that the app does not run twice.
+        verbosePrintln("Stopping {}, as the app has already been executed directly.", unitName);
+        DBusMessage stopReq = bus.createMethodCall(
+                "org.freedesktop.systemd1",
+                "/org/freedesktop/systemd1",
+                "org.freedesktop.systemd1.Manager",
+                "StopUnit");
+        stopReq.append("ss", unitName, "replace");
+        callIgnoringErrors(bus, stopReq, "stop service");
+    }
+
+    CmdlineArgs scopeArgs = args;
+    scopeArgs.isScope = true;
+    scopeArgs.boostSec.reset();  // the startup phase is (mostly) over by now
+    const std::string scopeName = buildUnitName(unitNamePrefix(unitName), true);
+    verbosePrintln("Moving directly executed {} into {}.", args.args[0], scopeName);
+
+    const DBusMessage scopeReq =
+            buildStartRequest(bus, scopeName.c_str(), description, scopeArgs, {}, nullptr, pid);
+    const JobTracker::Job& scopeJob = jobs.callAsync(scopeReq);
+    bus.driveUntil([&] { return scopeJob.isDone(); });
+
+    if (scopeJob.result != "done") {
+        throw std::runtime_error(std::format(
+                "failed to move directly executed app into a scope: {}", scopeJob.result));
+    }
+}
+
+
+// Queue a request for the cgroup of the systemd instance itself (such as
+// "/user.slice/user-1000.slice/user@1000.service"), to be stored in 'cgroup'. The
+// returned handler must be kept alive until the reply has been received.
+DBusHandler getManagerCgroupAsync(DBus& bus, std::optional<std::string>& cgroup)
+{
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.DBus.Properties",
+            "Get");
+    req.append("ss", "org.freedesktop.systemd1.Manager", "ControlGroup");
+
+    DBusHandler onResponse = bus.createHandler([&cgroup](DBusMessage& resp) {
+        const char* value{};
+        resp.read("v", "s", &value);
+        cgroup = value;
+    });
+    bus.callAsync(req, onResponse);
+    return onResponse;
+}
+
+
+// Queue a request for a transient timer that ends the --boost window of the given unit
+// after the given number of seconds, by resetting its CPU and IO weights to their
+// defaults. Leaving this to systemd spares us a helper process, which (in scope mode)
+// would otherwise stay behind in the app's unit. If the unit has gone away by the time
+// the timer elapses, there is nothing left to reset, and the timer's service ignores
+// the failure. The returned handler must be kept alive until the reply has been received.
+DBusHandler scheduleBoostEndAsync(DBus& bus, const char* unitName, unsigned seconds)
+{
+    const std::string serviceName = buildUnitName(std::string_view("runapp-boost"), false);
+    const std::string timerName =
+            serviceName.substr(0, serviceName.size() - std::strlen(".service")) + ".timer";
+    const std::string description = std::format("End CPU/IO boost of {}", unitName);
+
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "StartTransientUnit");
+    req.append("ss", timerName.c_str(), "fail");
+    req.openContainer('a', "(sv)");
+    req.append("(sv)", "Description", "s", description.c_str());
+    req.append("(sv)", "RemainAfterElapse", "b", 0);
+    req.append("(sv)", "AccuracyUSec", "t", std::uint64_t(100'000));
+    req.append("(sv)", "TimersMonotonic", "a(st)", 1,
+               "OnActiveUSec", std::uint64_t(seconds) * 1'000'000);
+    req.closeContainer();
+
+    // Begin 'aux' arg: the service that the timer activates.
+    req.openContainer('a', "(sa(sv))");
+    req.openContainer('r', "sa(sv)");
+    req.append("s", serviceName.c_str());
+    req.openContainer('a', "(sv)");
+    req.append("(sv)", "Description", "s", description.c_str());
+    req.append("(sv)", "CollectMode", "s", "inactive-or-failed");
+    appendExecStart(req, boostEndCommand(unitName), true);
+    req.closeContainer();
+    req.closeContainer();
+    req.closeContainer();
+    // End 'aux' arg
+
+    DBusHandler handler = bus.createHandler(
+            [](DBusMessage&) {},
+            [](const sd_bus_error& err) {
+                verbosePrintln("Failed to schedule end of CPU/IO boost: {}",
+                               err.message ? err.message : err.name);
+            });
+    bus.callAsync(req, handler);
+    verbosePrintln("Scheduled end of CPU/IO boost via {} in {} s.", timerName, seconds);
+    return handler;
+}
+
+
+// Outcome of startUnit().
+enum class StartOutcome {
+    Started,  // the unit has been started
+    Adopted,  // the deadline has passed, and the command has been executed directly
+              // by a child process, which has then been moved into a scope
+};
+
+
+// Points in time during startUnit(), for the launch latency statistics.
+struct StartTimes {
+    DBus::Clock::time_point connecting, connected, requestSent, replied, jobRemoved;
+};
+
+
+// Start the unit for the given command. 'whileWaiting' is called once the start
+// request has been sent, to get work done while waiting for systemd. If the command
+// ends up being executed directly (see -x/--deadline-exec), 'beforeExec' is passed
+// to executeCommand().
+StartOutcome startUnit(const char* unitName, const char* description, const CmdlineArgs& args,
+                       const fs::path& execPath,
+                       const ArgList* extraArgs, const std::string* templateDropIn,
+                       std::optional<DBus::Clock::time_point> deadline,
+                       const std::optional<std::string>& desktopID,
+                       const std::function<void()>& whileWaiting,
+                       const std::function<void()>& beforeExec,
+                       StartTimes& times)
+{
+    times.connecting = DBus::Clock::now();
+    DBus bus = DBus::systemdUserBus();
+    times.connected = DBus::Clock::now();
+    bus.setDeadline(deadline);
+
+    // Set up D-Bus signal handlers so we get to know about the result of
+    // starting the job.
+    JobTracker jobs(bus);
+    const JobTracker::Job* startJob = nullptr;
+
+    // The instance environment file is only needed until the service has started.
+    FileRemover envFileRemover{args.isTemplate ? instanceEnvFilePath(unitName) : fs::path()};
+
+    try {
+        // With --delegate, a service learns where its delegated subtree is from the
+        // environment (in scope mode, main() sees to that), which takes the cgroup of
+        // systemd itself; ask for it first, so that the reply is on its way meanwhile.
+        std::optional<std::string> managerCgroup;
+        std::optional<DBusHandler> onCgroupResponse;
+        if (args.delegateControllers && !args.isScope) {
+            onCgroupResponse = getManagerCgroupAsync(bus, managerCgroup);
+        }
+
+        if (templateDropIn) {
+            const std::string templateName = std::format("{}@.service", unitNamePrefix(unitName));
+            installTemplate(bus, templateName, *templateDropIn);
+        }
+
+        std::optional<DBusHandler> onSliceResponse;
+        if (const SliceTier* tier = sliceTier(args)) {
+            onSliceResponse = ensureSliceAsync(bus, *tier);
+        }
+        std::vector<DBusHandler> onGroupSliceResponses;
+        if (args.group) {
+            onGroupSliceResponses = ensureGroupSliceAsync(bus, args);
+        }
+
+        const CmdlineArgs* unitArgs = &args;
+        CmdlineArgs delegatedArgs;
+        std::string cgroupEnv;
+        if (onCgroupResponse) {
+            bus.driveUntil([&] { return managerCgroup.has_value(); });
+            cgroupEnv = std::format("{}=/sys/fs/cgroup{}/{}/{}", DelegatedCgroupVar,
+                                    *managerCgroup, sliceCgroupPath(unitSlice(args)), unitName);
+            delegatedArgs = args;
+            delegatedArgs.env.push_back(cgroupEnv.c_str());
+            unitArgs = &delegatedArgs;
+        }
+
+        if (templateDropIn) {
+            writeInstanceEnvFile(unitName, *unitArgs);
+        }
+        const DBusMessage req = args.isTemplate
+                ? buildTemplateStartRequest(bus, unitName)
+                : buildStartRequest(bus, unitName, description, *unitArgs, execPath, extraArgs);
+
+        if (args.isScope) {
+            verbosePrintln("Starting {}; will execute: {}.", description, args.args);
+        }
+        else if (args.socket) {
+            verbosePrintln("Listening on {} for {}: {}.", *args.socket, description, args.args);
+        }
+        else if (extraArgs) {
+            verbosePrintln("Launching {}: {}, plus {} arguments from {}.",
+                           description, args.args, extraArgs->count(), *args.argsFrom);
+        }
+        else {
+            verbosePrintln("Launching {}: {}.", description, args.args);
+        }
+
+        times.requestSent = DBus::Clock::now();
+        startJob = &jobs.callAsync(req);
+
+        std::optional<DBusHandler> onBoostEndResponse;
+        if (isBoosted(args)) {
+            onBoostEndResponse = scheduleBoostEndAsync(bus, unitName, *args.boostSec);
+        }
+        whileWaiting();
+
+        bus.driveUntil([&] { return startJob->isDone(); });
+    }
+    catch (const DBusTimeout&) {
+        if (!args.isDeadlineExec) {
+            if (!startJob || args.isScope) {
+                // A scope is gone with us, and so the app would not run anyway.
+                throw std::runtime_error(std::format(
+                        "systemd did not respond within {} ms", *args.deadlineMs));
+            }
+            // Otherwise, systemd would still launch the app once it gets round to our
+            // request. Queue a request to stop the unit after it, which cancels the start
+            // job if that is still pending; closing the bus sends it without waiting.
+            DBusMessage stopReq = bus.createMethodCall(
+                    "org.freedesktop.systemd1",
+                    "/org/freedesktop/systemd1",
+                    "org.freedesktop.systemd1.Manager",
+                    "StopUnit");
+            stopReq.append("ss", unitName, "replace");
+            const DBusHandler onStopResponse =
+                    bus.createHandler([](DBusMessage&) {}, [](const sd_bus_error&) {});
+            bus.callAsync(stopReq, onStopResponse);
+            throw std::runtime_error(std::format(
+                    "systemd did not respond within {} ms; the launch has been canceled",
+                    *args.deadlineMs));
+        }
+
+        const pid_t child = fork();
+        if (child == -1) {
+            throwSystemError("fork", errno);
+        }
+        if (child == 0) {
+            // The bus connection (like the instance environment file) belongs to the
+            // parent, so neither return nor exit normally, which would close it.
+            try {
+                verbosePrintln("Executing {}.", args.args[0]);
+                executeCommand(args, beforeExec);
+            }
+            catch (const std::exception& e) {
+                fdPrintln(STDERR_FILENO, "Failed to execute {}: {}", args.args[0], e.what());
+            }
+            _exit(127);
+        }
+
+        reportError(std::format("{} was started directly, as systemd did not respond "
+                                "within {} ms", description, *args.deadlineMs),
+                    desktopID);
+
+        bus.setDeadline(DBus::Clock::now() + AdoptionTimeout);
+        try {
+            adoptDirectlyExecuted(bus, unitName, description, args, child, jobs, startJob);
+        }
+        catch (const DBusTimeout&) {
+            // If systemd does get round to starting the service after all, the app
+            // will run twice; but there is nothing left for us to do about that.
+            throw std::runtime_error(std::format(
+                    "it was started directly, but systemd did not respond within a further "
+                    "{} s to take it over", AdoptionTimeout.count()));
+        }
+
+        if (args.delegateControllers) {
+            // The app is running in its scope now, so this is no reason to fail.
+            try {
+                moveAdoptedIntoDelegatedSubgroup(child);
+            }
+            catch (const std::exception& e) {
+                fdPrintln(STDERR_FILENO, "Failed to move {} into its delegated subgroup: {}",
+                          args.args[0], e.what());
+            }
+        }
+        return StartOutcome::Adopted;
+    }
+
+    times.replied = startJob->replyTime;
+    times.jobRemoved = startJob->removeTime;
+    if (startJob->result == "failed") {
+        throw std::runtime_error("startup failure");
+    }
+    if (startJob->result != "done") {
+        throw std::runtime_error(startJob->result);
+    }
+    return StartOutcome::Started;
+}
+
+
+// Apply the defaults from the app's section of runapp.conf, where not overridden
+// on the command line (or not applicable to the mode, see parseArgs()).
+void applyAppConfig(CmdlineArgs& args, std::string_view appName)
+{
+    const AppConfig appConfig = loadAppConfig(appName);
+    if (!args.boostSec && !args.socket) {
+        args.boostSec = appConfig.boostSec;
+    }
+    if (!args.output) {
+        args.output = appConfig.output;
+    }
+    if (!args.isScope) {
+        if (!args.logRateLimit) {
+            args.logRateLimit = appConfig.logRateLimit;
+        }
+        if (!args.logLevelMax) {
+            args.logLevelMax = appConfig.logLevelMax;
+        }
+    }
+}
+
+
+int runAutostart(const CmdlineArgs& args)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point beginTime = Clock::now();
+    const std::vector<AutostartEntry> entries = findAutostartEntries();
+    verbosePrintln("Found {} autostart entries.", entries.size());
+
+    DBus bus = DBus::systemdUserBus();
+
+    // All start requests go out over the same connection; at most 'maxActive'
+    // of them are in flight (i.e. waiting for their job to complete) at any time,
+    // and they are issued in order of priority.
+
+    const unsigned maxActive = args.jobs.value_or(8);
+    std::size_t next = 0;
+    unsigned failures = 0;
+
+    JobTracker jobs(bus);
+    std::vector<DBusHandler> handlers;
+
+    std::optional<DBusHandler> onSliceResponse;
+    if (const SliceTier* tier = sliceTier(args)) {
+        onSliceResponse = ensureSliceAsync(bus, *tier);
+    }
+
+    const auto startNext = [&] {
+        const AutostartEntry& entry = entries[next++];
+
+        try {
+            std::vector<const char*> argv;
+            for (const std::string& arg : entry.exec) {
+                argv.push_back(arg.c_str());
+            }
+            argv.push_back(nullptr);
+
+            CmdlineArgs entryArgs = args;
+            entryArgs.args = std::span(argv.data(), argv.size() - 1);
+            if (entry.workingDir) {
+                entryArgs.workingDir = entry.workingDir->c_str();
+            }
+            applyAppConfig(entryArgs, entry.id);
+
+            const std::string unitName = buildUnitName(entry.id, entryArgs);
+            const DBusMessage req = buildStartRequest(
+                    bus, unitName.c_str(), entry.name.c_str(), entryArgs,
+                    resolveExecutable(entryArgs.args[0]));
+            verbosePrintln("Launching {}: {}.", unitName, entryArgs.args);
+
+            const Clock::time_point startTime = Clock::now();
+            jobs.callAsync(req, [&, unitName, startTime](const JobTracker::Job& job) {
+                const std::chrono::duration<double, std::milli> elapsed =
+                        job.removeTime - startTime;
+                if (job.result == "done") {
+                    fdPrintln(STDOUT_FILENO, "Started {} ({}) in {:.1f} ms.",
+                              unitName, entry.name, elapsed.count());
+                    return;
+                }
+                fdPrintln(STDERR_FILENO, "Failed to start {} ({}) after {:.1f} ms: {}",
+                          unitName, entry.name, elapsed.count(),
+                          job.result == "failed" ? "startup failure" : job.result);
+                ++failures;
+            });
+
+            if (isBoosted(entryArgs)) {
+                handlers.push_back(scheduleBoostEndAsync(
+                        bus, unitName.c_str(), *entryArgs.boostSec));
+            }
+        }
+        catch (const std::exception& e) {
+            ++failures;
+            fdPrintln(STDERR_FILENO, "Failed to start autostart entry {}: {}", entry.id, e.what());
+        }
+    };
+
+    while (next < entries.size() || jobs.pendingCount() > 0) {
+        while (next < entries.size() && jobs.pendingCount() < maxActive) {
+            startNext();
+        }
+        if (jobs.pendingCount() > 0) {
+            bus.drive();
+        }
+    }
+
+    verbosePrintln("Started {} of {} autostart entries in {} ms.",
+                   entries.size() - failures, entries.size(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                           Clock::now() - beginTime).count());
+
+    return failures == 0 ? 0 : 1;
+}
+
+
+// Return the unit name patterns for the given --stop argument. Arguments ending in a
+// unit type suffix are glob patterns, or unit names (such as that of a --group's
+// slice, which may contain backslashes) if they contain no glob characters; anything
+// else is taken to be an app name, which matches all units that runapp creates for
+// that app.
+std::vector<std::string> stopPatterns(std::string_view arg)
+{
+    for (const std::string_view suffix : {".service", ".scope", ".socket", ".slice"}) {
+        if (arg.ends_with(suffix)) {
+            if (arg.find_first_of("*?[") == std::string_view::npos) {
+                return {literalUnitNameGlob(arg)};
+            }
+            return {std::string(arg)};
+        }
+    }
+
+    return unitNamePatterns(appUnitPrefix(std::string(arg)));
+}
+
+
+std::vector<std::string> listUnits(DBus& bus, const std::vector<std::string>& patterns)
+{
+    DBusMessage req = bus.createMethodCall(
+            "org.freedesktop.systemd1",
+            "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager",
+            "ListUnitsByPatterns");
+    req.openContainer('a', "s");  // states
+    for (const char* state : {"active", "activating", "deactivating", "reloading"}) {
+        req.append("s", state);
+    }
+    req.closeContainer();
+    req.openContainer('a', "s");  // patterns
+    for (const std::string& pattern : patterns) {
+        req.append("s", pattern.c_str());
+    }
+    req.closeContainer();
+
+    std::vector<std::string> unitNames;
+    bool done = false;
+    auto onResponse = bus.createHandler([&](DBusMessage& resp) {
+        resp.enterContainer('a', "(ssssssouso)");
+        const char* name{};
+        while (resp.tryRead("(ssssssouso)", &name, nullptr, nullptr, nullptr, nullptr,
+                            nullptr, nullptr, nullptr, nullptr, nullptr))
+        {
+            unitNames.emplace_back(name);
+        }
+        resp.exitContainer();
+        done = true;
+    });
+    bus.callAsync(req, onResponse);
+    bus.driveUntil([&] { return done; });
+
+    std::ranges::sort(unitNames);
+    return unitNames;
+}
+
+
+int runStop(const CmdlineArgs& args)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point beginTime = Clock::now();
+    DBus bus = DBus::systemdUserBus();
+
+    std::vector<std::string> patterns;
+    for (const char* arg : args.args) {
+        std::ranges::copy(stopPatterns(arg), std::back_inserter(patterns));
+    }
+    verbosePrintln("Looking for units matching {}.", patterns);
+    const std::vector<std::string> unitNames = listUnits(bus, patterns);
+    if (unitNames.empty()) {
+        fdPrintln(STDOUT_FILENO, "No matching units.");
+        return 0;
+    }
+
+    // All stop requests go out at once, over the same connection, and we then wait
+    // for all the stop jobs to complete, as in runAutostart().
+
+    struct Stop {
+        const std::string* unitName;
+        const JobTracker::Job* job;
+        Clock::time_point startTime;
+        bool isKilled;
+    };
+
+    std::vector<Stop> stops;
+    stops.reserve(unitNames.size());
+    JobTracker jobs(bus);
+    std::vector<DBusHandler> handlers;
+    unsigned failures = 0;
+
+    for (const std::string& unitName : unitNames) {
+        const std::size_t index = stops.size();
+        stops.push_back({&unitName, nullptr, {}, false});
+
+        DBusMessage req = bus.createMethodCall(
+                "org.freedesktop.systemd1",
+                "/org/freedesktop/systemd1",
+                "org.freedesktop.systemd1.Manager",
+                "StopUnit");
+        req.append("ss", unitName.c_str(), "replace");
+        verbosePrintln("Stopping {}.", unitName);
+
+        stops[index].startTime = Clock::now();
+        stops[index].job = &jobs.callAsync(req, [&stops, &failures, index](
+                const JobTracker::Job& job) {
+            const Stop& stop = stops[index];
+            const std::chrono::duration<double, std::milli> elapsed =
+                    job.removeTime - stop.startTime;
+            if (job.result == "done") {
+                fdPrintln(STDOUT_FILENO, "Stopped {} in {:.1f} ms{}.", *stop.unitName,
+                          elapsed.count(), stop.isKilled ? ", after killing it" : "");
+                return;
+            }
+            fdPrintln(STDERR_FILENO, "Failed to stop {} after {:.1f} ms: {}",
+                      *stop.unitName, elapsed.count(), job.result);
+            ++failures;
+        });
+    }
+
+    // StopUnit sends SIGTERM, and only escalates to SIGKILL after the unit's
+    // TimeoutStopSec= (90 s by default); with --stop-timeout, we escalate earlier.
+    if (args.stopTimeoutSec) {
+        bus.setDeadline(beginTime + std::chrono::seconds(*args.stopTimeoutSec));
+        try {
+            bus.driveUntil([&] { return jobs.pendingCount() == 0; });
+        }
+        catch (const DBusTimeout&) {
+            bus.setDeadline({});
+            for (Stop& stop : stops) {
+                if (stop.job->isDone()) {
+                    continue;
+                }
+                verbosePrintln("Killing {}, as it did not stop within {} s.",
+                               *stop.unitName, *args.stopTimeoutSec);
+                stop.isKilled = true;
+                DBusMessage killReq = bus.createMethodCall(
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "KillUnit");
+                killReq.append("ssi", stop.unitName->c_str(), "all", SIGKILL);
+                handlers.push_back(bus.createHandler(
+                        [](DBusMessage&) { },
+                        [&stop](const sd_bus_error& err) {
+                            verbosePrintln("Failed to kill {}: {}", *stop.unitName,
+                                           err.message ? err.message : err.name);
+                        }));
+                bus.callAsync(killReq, handlers.back());
+            }
+        }
+    }
+    bus.driveUntil([&] { return jobs.pendingCount() == 0; });
+
+    verbosePrintln("Stopped {} of {} units in {} ms.",
+                   unitNames.size() - failures, unitNames.size(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                           Clock::now() - beginTime).count());
+
+    return failures == 0 ? 0 : 1;
+}
+
+
+// Add the launch to the statistics shown by --latency-report.
+void recordLaunchLatency(const LatencyRecorder& recorder, const std::string& appName,
+                         const CmdlineArgs& args, DBus::Clock::time_point startTime,
+                         const StartTimes& times)
+{
+    const auto usec = [](DBus::Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d);
+    };
+    const LaunchPhaseDurations durations = {
+        usec(times.connected - times.connecting),    // LaunchPhase::Connect
+        usec(times.requestSent - times.connected),   // LaunchPhase::Prepare
+        usec(times.replied - times.requestSent),     // LaunchPhase::Reply
+        usec(times.jobRemoved - times.replied),      // LaunchPhase::Job
+        usec(times.jobRemoved - startTime),          // LaunchPhase::Total
+    };
+    recorder.record(appName, args.isScope ? "scope" : args.isTemplate ? "template" : "service",
+                    durations);
+}
+
+
+int runPrewarm(const CmdlineArgs& args)
+{
+    // Move ourselves into a scope in the background slice first, so that our IO
+    // (idle priority notwithstanding) and CPU time are accounted as background work.
+    try {
+        CmdlineArgs scopeArgs = args;
+        scopeArgs.isScope = true;
+        scopeArgs.isBackground = !args.slice;
+        const std::string unitName = buildUnitName(std::string("runapp-prewarm"), scopeArgs);
+
+        DBus bus = DBus::systemdUserBus();
+        std::optional<DBusHandler> onSliceResponse;
+        if (const SliceTier* tier = sliceTier(scopeArgs)) {
+            onSliceResponse = ensureSliceAsync(bus, *tier);
+        }
+        const DBusMessage req =
+                buildStartRequest(bus, unitName.c_str(), "runapp prewarm", scopeArgs, {});
+        verbosePrintln("Moving into {} in {}.", unitName, unitSlice(scopeArgs));
+        callIgnoringErrors(bus, req, "create scope");
+    }
+    catch (const std::exception& e) {
+        verbosePrintln("Failed to create scope: {}", e.what());
+    }
+
+    try {
+        prewarm(*args.prewarm);
+    }
+    catch (const std::exception& e) {
+        fdPrintln(STDERR_FILENO, "Failed to prewarm: {}", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+    const DBus::Clock::time_point startTime = DBus::Clock::now();
+
+    CmdlineArgs args;
+    if (auto a = parseArgs(argc, argv)) {
+        args = std::move(*a);
+    }
+    else {
+        return 2;
+    }
+
+    if (args.isHelp) {
+        return 0;
+    }
+
+    g_verbose = args.isVerbose;
+
+    if (args.prewarm) {
+        return runPrewarm(args);
+    }
+
+    if (args.isLatencyReport) {
+        try {
+            printLatencyReport(args.isLatencyReportJson);
+            return 0;
+        }
+        catch (const std::exception& e) {
+            fdPrintln(STDERR_FILENO, "Failed to report launch latencies: {}", e.what());
+            return 1;
+        }
+    }
+
+    if (args.isStop) {
+        try {
+            return runStop(args);
+        }
+        catch (const std::exception& e) {
+            fdPrintln(STDERR_FILENO, "Failed to stop units: {}", e.what());
+            return 1;
+        }
+    }
+
+    if (args.isAutostart) {
+        try {
+            return runAutostart(args);
+        }
+        catch (const std::exception& e) {
+            fdPrintln(STDERR_FILENO, "Failed to run autostart entries: {}", e.what());
+            return 1;
+        }
+    }
 
     const std::optional<std::string> desktopID = envDesktopEntryID();
     const std::string appName =
@@ -424,27 +1733,90 @@ int main(int argc, char* argv[])
     const char* description = args.description.value_or(appName.c_str());
 
     try {
-        // Start transient systemd unit (.service or .scope).
-        const std::string unitName = buildUnitName(appName, args);
-        startUnit(unitName.c_str(), description, args);
+        applyAppConfig(args, appName);
+        if (args.group) {
+            const GroupLimits groupLimits = loadGroupLimits(*args.group);
+            if (!args.groupLimits.memoryMax) {
+                args.groupLimits.memoryMax = groupLimits.memoryMax;
+            }
+            if (!args.groupLimits.memoryHigh) {
+                args.groupLimits.memoryHigh = groupLimits.memoryHigh;
+            }
+            if (!args.groupLimits.cpuQuotaPercent) {
+                args.groupLimits.cpuQuotaPercent = groupLimits.cpuQuotaPercent;
+            }
+        }
 
-        if (args.isScope) {
+        // Start transient systemd unit (.service or .scope), or an instance of the
+        // template for this app and option set.
+        // (A scope's command is only looked up by execvp(), see executeCommand().)
+        const fs::path execPath = args.isScope ? fs::path() : resolveExecutable(args.args[0]);
+        std::optional<std::string> templateDropIn;
+        if (args.isTemplate) {
+            templateDropIn = buildTemplateDropIn(description, args, execPath);
+        }
+        const std::string unitName = templateDropIn
+                ? buildUnitName(templateUnitPrefix(appUnitPrefix(appName), *templateDropIn), false)
+                : buildUnitName(appName, args);
+        std::optional<ArgList> extraArgs;
+        if (args.argsFrom) {
+            extraArgs.emplace(*args.argsFrom);
+        }
+        std::optional<DBus::Clock::time_point> deadline;
+        if (args.deadlineMs) {
+            deadline = startTime + std::chrono::milliseconds(*args.deadlineMs);
+        }
+        // Remember a directly executed command for --prewarm (failing to do so is
+        // not an error), looking it up as execvp() will.
+        const auto recordDirectLaunch = [&] {
+            try {
+                recordLaunch(appName, resolveExecutable(args.args[0]));
+            }
+            catch (const std::exception& e) {
+                verbosePrintln("Failed to record launch in history: {}", e.what());
+            }
+        };
+        // Map the latency file while waiting for systemd, so that recording the launch
+        // does not hold up executing a scope's command. With --socket, the app has not
+        // actually been launched yet.
+        std::optional<LatencyRecorder> latencyRecorder;
+        const auto whileWaiting = [&] {
+            if (!args.socket) {
+                latencyRecorder.emplace();
+            }
+        };
+        StartTimes times;
+        const StartOutcome outcome = startUnit(unitName.c_str(), description, args, execPath,
+                                               extraArgs ? &*extraArgs : nullptr,
+                                               templateDropIn ? &*templateDropIn : nullptr,
+                                               deadline, desktopID, whileWaiting,
+                                               recordDirectLaunch, times);
+
+        if (outcome == StartOutcome::Started && !args.socket) {
+            recordLaunchLatency(*latencyRecorder, appName, args, startTime, times);
+            if (!args.isScope) {
+                recordLaunch(appName, execPath);
+            }
+        }
+
+        if (outcome == StartOutcome::Started && args.isScope) {
             // For a scope unit, we now need to execute the command ourselves.
+            std::string cgroupEnv;
+            if (args.delegateControllers) {
+                const fs::path delegatedDir = cgroupDirOf(getpid());
+                moveIntoDelegatedSubgroup(delegatedDir, getpid());
+                cgroupEnv = std::format("{}={}", DelegatedCgroupVar, delegatedDir.native());
+                args.env.push_back(cgroupEnv.c_str());
+            }
             verbosePrintln("Executing {}.", args.args[0]);
-            executeCommand(args);
+            executeCommand(args, recordDirectLaunch);
         }
         else {
             verbosePrintln("Success.");
         }
     }
     catch (const std::exception& e) {
-        const std::string errmsg =
-                std::format("Failed to start {}: {}", description, e.what());
-        std::println(std::cerr, "{}", errmsg);
-        if (!isatty(STDIN_FILENO)) {
-            verbosePrintln("Notifying user of error via org.freedesktop.Notifications.");
-            notifyErrorFreedesktop(errmsg, desktopID);
-        }
+        reportError(std::format("Failed to start {}: {}", description, e.what()), desktopID);
         return 1;
     }
 }
@@ -0,0 +1,31 @@
+#include "output.h"
+
+#include <cerrno>
+#include <string>
+
+
+bool writeAll(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        const ssize_t n = write(fd, data.data(), data.size());
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(n);
+    }
+    return true;
+}
+
+
+void fdVPrint(int fd, std::string_view fmt, std::format_args args, bool newline)
+{
+    std::string text = std::vformat(fmt, args);
+    if (newline) {
+        text += '\n';
+    }
+    // Output errors are deliberately ignored: there is nowhere left to report them.
+    (void) writeAll(fd, text);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <format>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+#include <unistd.h>
+}
+
+// Minimal output layer writing directly to file descriptors, so that runapp
+// does not pay for initializing iostreams on every launch. Output is formatted
+// into a string, which is then emitted with a single write(). Formatting to a
+// string reuses the std::format() machinery that runapp needs anyway, rather
+// than instantiating it once more for an output iterator of its own.
+
+
+// Write all of the given data to the given file descriptor, retrying on short writes
+// and EINTR. Return false (with errno set) on error.
+bool writeAll(int fd, std::string_view data);
+
+void fdVPrint(int fd, std::string_view fmt, std::format_args args, bool newline);
+
+
+template<class... Args>
+void fdPrint(int fd, std::format_string<Args...> fmt, Args&&... args)
+{
+    fdVPrint(fd, fmt.get(), std::make_format_args(args...), false);
+}
+
+template<class... Args>
+void fdPrintln(int fd, std::format_string<Args...> fmt, Args&&... args)
+{
+    fdVPrint(fd, fmt.get(), std::make_format_args(args...), true);
+}
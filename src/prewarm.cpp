@@ -0,0 +1,323 @@
+#include "prewarm.h"
+#include "history.h"
+#include "verbose.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <link.h>
+#include <linux/ioprio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Launches lose half their weight in the ranking after this long.
+constexpr double HalfLifeDays = 7;
+
+
+void setIdleIoPriority()
+{
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)) != 0)
+    {
+        verbosePrintln("Failed to set idle IO priority: {}",
+                       std::generic_category().message(errno));
+    }
+}
+
+
+// Rank the executables in the launch history by number of launches, each weighted
+// by how recent it is, and return the top 'count' of them.
+std::vector<fs::path> rankExecutables(unsigned count)
+{
+    const std::vector<LaunchRecord> records = readLaunchHistory();
+    verbosePrintln("Read {} launch records.", records.size());
+
+    const double nowUsec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    constexpr double HalfLifeUsec = HalfLifeDays * 24 * 3600 * 1e6;
+
+    std::map<fs::path, double> scores;
+    for (const LaunchRecord& r : records) {
+        const double age = std::max(0.0, nowUsec - double(r.timeUsec));
+        scores[r.path] += std::exp2(-age / HalfLifeUsec);
+    }
+
+    std::vector<std::pair<fs::path, double>> ranked(scores.begin(), scores.end());
+    std::ranges::sort(ranked, std::ranges::greater{}, &std::pair<fs::path, double>::second);
+    if (ranked.size() > count) {
+        ranked.resize(count);
+    }
+
+    std::vector<fs::path> paths;
+    for (auto& [path, score] : ranked) {
+        verbosePrintln("Prewarming {} (score {:.2f}).", path.native(), score);
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+
+struct ElfDeps {
+    std::vector<std::string> needed;   // DT_NEEDED entries
+    std::vector<std::string> runpath;  // DT_RUNPATH (or DT_RPATH) directories
+};
+
+
+// Extract the dynamic dependencies of the given ELF file (of the native class), or
+// return std::nullopt if it is not one (e.g. a script), or is statically linked.
+std::optional<ElfDeps> readElfDeps(std::string_view file)
+{
+    using Ehdr = ElfW(Ehdr);
+    using Phdr = ElfW(Phdr);
+    using Dyn = ElfW(Dyn);
+
+    Ehdr ehdr;
+    if (file.size() < sizeof ehdr) {
+        return {};
+    }
+    std::memcpy(&ehdr, file.data(), sizeof ehdr);
+    if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+        || ehdr.e_ident[EI_CLASS] != (sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32)
+        || ehdr.e_phentsize != sizeof(Phdr)
+        || ehdr.e_phoff > file.size()
+        || ehdr.e_phnum > (file.size() - ehdr.e_phoff) / sizeof(Phdr))
+    {
+        return {};
+    }
+
+    std::vector<Phdr> phdrs(ehdr.e_phnum);
+    std::memcpy(phdrs.data(), file.data() + ehdr.e_phoff, ehdr.e_phnum * sizeof(Phdr));
+
+    const auto dynamic = std::ranges::find(phdrs, ElfW(Word)(PT_DYNAMIC), &Phdr::p_type);
+    if (dynamic == phdrs.end()
+        || dynamic->p_offset > file.size()
+        || dynamic->p_filesz > file.size() - dynamic->p_offset)
+    {
+        return {};
+    }
+
+    // Dynamic entries give the string table as a virtual address; map it to a file offset.
+    const auto toOffset = [&](ElfW(Addr) addr) -> std::optional<std::size_t> {
+        for (const Phdr& p : phdrs) {
+            if (p.p_type == PT_LOAD && p.p_vaddr <= addr && addr - p.p_vaddr < p.p_filesz) {
+                return addr - p.p_vaddr + p.p_offset;
+            }
+        }
+        return {};
+    };
+
+    std::optional<std::size_t> strtab;
+    std::vector<ElfW(Xword)> neededOffsets, runpathOffsets;
+    const std::size_t dynCount = dynamic->p_filesz / sizeof(Dyn);
+    for (std::size_t i = 0; i < dynCount; ++i) {
+        Dyn dyn;
+        std::memcpy(&dyn, file.data() + dynamic->p_offset + i * sizeof dyn, sizeof dyn);
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        switch (dyn.d_tag) {
+        case DT_STRTAB: strtab = toOffset(dyn.d_un.d_ptr); break;
+        case DT_NEEDED: neededOffsets.push_back(dyn.d_un.d_val); break;
+        case DT_RUNPATH:
+        case DT_RPATH: runpathOffsets.push_back(dyn.d_un.d_val); break;
+        }
+    }
+    if (!strtab || *strtab >= file.size()) {
+        return {};
+    }
+
+    const std::string_view strings = file.substr(*strtab);
+    const auto getString = [&](ElfW(Xword) offset) -> std::string_view {
+        if (offset >= strings.size()) {
+            return {};
+        }
+        const std::string_view s = strings.substr(offset);
+        return s.substr(0, s.find('\0'));
+    };
+
+    ElfDeps deps;
+    for (const ElfW(Xword) offset : neededOffsets) {
+        if (const std::string_view name = getString(offset); !name.empty()) {
+            deps.needed.emplace_back(name);
+        }
+    }
+    for (const ElfW(Xword) offset : runpathOffsets) {
+        for (const auto dir : getString(offset) | std::views::split(':')) {
+            if (!dir.empty()) {
+                deps.runpath.emplace_back(std::string_view(dir));
+            }
+        }
+    }
+    return deps;
+}
+
+
+// Return the directory that our own libc was loaded from, i.e. the system library
+// directory as the dynamic linker sees it (e.g. /usr/lib or /usr/lib/x86_64-linux-gnu).
+std::optional<fs::path> ownLibcDir()
+{
+    std::optional<fs::path> dir;
+    dl_iterate_phdr([](dl_phdr_info* info, std::size_t, void* data) {
+        const fs::path path = info->dlpi_name;
+        if (path.filename().native().starts_with("libc.so")) {
+            *static_cast<std::optional<fs::path>*>(data) = path.parent_path();
+            return 1;
+        }
+        return 0;
+    }, &dir);
+    return dir;
+}
+
+
+class Prewarmer {
+  public:
+    Prewarmer()
+    {
+        if (std::optional<fs::path> libcDir = ownLibcDir()) {
+            d_libDirs.push_back(std::move(*libcDir));
+        }
+        for (const char* dir : {"/usr/lib64", "/lib64", "/usr/lib", "/lib"}) {
+            d_libDirs.emplace_back(dir);
+        }
+    }
+
+    // Read the given file, and (recursively) the shared libraries it needs.
+    void prewarm(const fs::path& path)
+    {
+        d_queue.push_back(path);
+        while (!d_queue.empty()) {
+            const fs::path file = std::move(d_queue.front());
+            d_queue.pop_front();
+            prewarmFile(file);
+        }
+    }
+
+    std::size_t fileCount() const noexcept { return d_seen.size(); }
+    std::size_t byteCount() const noexcept { return d_bytes; }
+
+  private:
+    void prewarmFile(const fs::path& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            verbosePrintln("Failed to open {}: {}", path.native(),
+                           std::generic_category().message(errno));
+            return;
+        }
+        struct stat st;
+        const bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+                        // The same library is typically reachable via several paths.
+                        && d_seen.emplace(st.st_dev, st.st_ino).second;
+        void* map = ok && st.st_size > 0
+                    ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                    : MAP_FAILED;
+        if (ok) {
+            // Issue the readahead first, so that the kernel can get going while we
+            // parse the dynamic section.
+            readahead(fd, 0, st.st_size);
+            d_bytes += st.st_size;
+        }
+        close(fd);
+        if (map == MAP_FAILED) {
+            return;
+        }
+
+        const std::optional<ElfDeps> deps = readElfDeps(
+                std::string_view(static_cast<const char*>(map), st.st_size));
+        munmap(map, st.st_size);
+        if (!deps) {
+            return;
+        }
+
+        for (const std::string& lib : deps->needed) {
+            if (std::optional<fs::path> libPath = findLibrary(lib, *deps, path.parent_path())) {
+                d_queue.push_back(std::move(*libPath));
+            }
+            else {
+                verbosePrintln("Cannot find {} (needed by {}).", lib, path.native());
+            }
+        }
+    }
+
+    std::optional<fs::path> findLibrary(const std::string& lib, const ElfDeps& deps,
+                                        const fs::path& origin) const
+    {
+        if (lib.contains('/')) {
+            return lib;
+        }
+        const auto tryDir = [&](const fs::path& dir) -> std::optional<fs::path> {
+            fs::path candidate = dir / lib;
+            if (access(candidate.c_str(), R_OK) == 0) {
+                return candidate;
+            }
+            return {};
+        };
+        for (std::string dir : deps.runpath) {
+            for (const std::string_view var : {"${ORIGIN}", "$ORIGIN"}) {
+                if (const std::size_t pos = dir.find(var); pos != std::string::npos) {
+                    dir.replace(pos, var.size(), origin.native());
+                }
+            }
+            if (auto candidate = tryDir(dir)) {
+                return candidate;
+            }
+        }
+        for (const fs::path& dir : d_libDirs) {
+            if (auto candidate = tryDir(dir)) {
+                return candidate;
+            }
+        }
+        return {};
+    }
+
+    std::vector<fs::path> d_libDirs;
+    std::deque<fs::path> d_queue;
+    std::set<std::pair<dev_t, ino_t>> d_seen;
+    std::size_t d_bytes{};
+};
+
+}
+
+
+void prewarm(unsigned appCount)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point beginTime = Clock::now();
+
+    setIdleIoPriority();
+
+    const std::vector<fs::path> executables = rankExecutables(appCount);
+    Prewarmer prewarmer;
+    for (const fs::path& path : executables) {
+        prewarmer.prewarm(path);
+    }
+
+    verbosePrintln("Prewarmed {} files ({} KiB) for {} apps in {} ms.",
+                   prewarmer.fileCount(), prewarmer.byteCount() / 1024, executables.size(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                           Clock::now() - beginTime).count());
+}
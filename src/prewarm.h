@@ -0,0 +1,6 @@
+#pragma once
+
+// Read the executables (and their shared libraries, recursively) of the given number
+// of apps into the page cache, choosing the apps that are most likely to be launched
+// next according to the launch history. Uses idle IO priority.
+void prewarm(unsigned appCount);
@@ -0,0 +1,130 @@
+#include "template.h"
+
+#include <cstdint>
+#include <cstring>
+#include <format>
+
+
+std::string quoteExecWord(std::string_view word)
+{
+    std::string quoted = "\"";
+    for (const char c : word) {
+        switch (c) {
+        case '"':
+        case '\\':
+            quoted += '\\';
+            quoted += c;
+            break;
+        case '\n':
+            quoted += "\\n";
+            break;
+        case '%':  // specifier
+            quoted += "%%";
+            break;
+        case '$':  // environment variable reference
+            quoted += "$$";
+            break;
+        default:
+            quoted += c;
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+
+std::size_t execWordLength(std::string_view word)
+{
+    std::size_t length = 3;  // quotes and space
+    for (const char c : word) {
+        const unsigned char u = c;
+        if (u < ' ' || u >= 0x7f) {
+            length += 4;  // at most "\xNN"
+        }
+        else {
+            length += std::strchr("\"\\'%$", c) ? 2 : 1;
+        }
+    }
+    return length;
+}
+
+
+std::string escapeUnitValue(std::string_view value)
+{
+    std::string escaped;
+    for (const char c : value) {
+        if (c == '%') {
+            escaped += "%%";
+        }
+        else {
+            escaped += c == '\n' ? ' ' : c;
+        }
+    }
+    return escaped;
+}
+
+
+std::string quoteEnvFileValue(std::string_view value)
+{
+    std::string quoted = "\"";
+    for (const char c : value) {
+        if (std::strchr("\"\\`$", c)) {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+
+std::string buildTemplateUnit()
+{
+    return "# Generated by runapp; any changes will be overwritten.\n"
+           "[Unit]\n"
+           "CollectMode=inactive-or-failed\n"
+           "\n"
+           "[Service]\n"
+           "Type=exec\n"
+           "ExitType=cgroup\n"
+           "EnvironmentFile=%t/runapp/%n.env\n";
+}
+
+
+std::string templateUnitPrefix(std::string_view appUnitPrefix, std::string_view dropIn)
+{
+    std::uint32_t hash = 0x811c9dc5;  // FNV-1a
+    for (const char c : dropIn) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x01000193;
+    }
+    return std::format("{}-{:08x}", appUnitPrefix, hash);
+}
+
+
+std::string buildInstanceEnvFile(std::span<const char* const> args,
+                                 std::span<const char* const> env)
+{
+    // systemd splits $RUNAPP_ARGS at whitespace, honouring quotes; so quote each
+    // argument, then quote the result once more for the environment file itself.
+    std::string argsValue;
+    for (const char* arg : args) {
+        if (!argsValue.empty()) {
+            argsValue += ' ';
+        }
+        argsValue += '"';
+        for (const char* c = arg; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                argsValue += '\\';
+            }
+            argsValue += *c;
+        }
+        argsValue += '"';
+    }
+
+    std::string content = std::format("RUNAPP_ARGS={}\n", quoteEnvFileValue(argsValue));
+    for (const std::string_view var : env) {
+        const std::size_t eq = var.find('=');
+        content += std::format("{}={}\n", var.substr(0, eq), quoteEnvFileValue(var.substr(eq + 1)));
+    }
+    return content;
+}
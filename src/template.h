@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Unit file text for template mode (-t/--template): rather than describing the
+// whole unit in each StartTransientUnit call, runapp installs a template unit
+// (plus a drop-in holding the settings specific to the app and option set) once,
+// and then starts instances of it. Whatever varies between launches (arguments
+// and environment) is passed via a per-instance environment file that the
+// template references.
+
+// Quote the given string as a single word of a unit file command line (ExecStart=).
+std::string quoteExecWord(std::string_view word);
+
+// The longest line that systemd reads from a unit file (LONG_LINE_MAX). This also
+// limits the ExecStart= of a transient service, which systemd writes to a unit file
+// of its own as a single line and reads back on each daemon reload.
+constexpr std::size_t UnitFileMaxLineLength = 1 << 20;
+
+// Return an upper bound of the length of the given word on the ExecStart= line that
+// systemd writes for a transient service (quoted, with C escapes, and with specifiers
+// and variable references doubled), plus a separating space.
+std::size_t execWordLength(std::string_view word);
+
+// Escape the given string for use as a single-line unit file setting value.
+std::string escapeUnitValue(std::string_view value);
+
+// Quote the given string as a value in an environment file (EnvironmentFile=).
+std::string quoteEnvFileValue(std::string_view value);
+
+// Return the template unit itself, which is the same for all apps.
+std::string buildTemplateUnit();
+
+// Return the prefix of the template unit name for the given app unit prefix and
+// drop-in. The name includes a hash of the drop-in, so that each option set gets a
+// template of its own: launches with different options neither rewrite each other's
+// drop-in (and reload systemd each time) nor race to do so.
+std::string templateUnitPrefix(std::string_view appUnitPrefix, std::string_view dropIn);
+
+// Return the content of the environment file of an instance, which passes the
+// given arguments (following argv[0]) as $RUNAPP_ARGS, plus the given
+// environment variables (NAME=VALUE).
+std::string buildInstanceEnvFile(std::span<const char* const> args,
+                                 std::span<const char* const> env);
@@ -0,0 +1,150 @@
+#include "unitname.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <iterator>
+
+
+namespace {
+
+constexpr std::string_view SliceSuffix = ".slice";
+
+// Return the name of the given slice without its suffix, "-" for the root slice.
+std::string_view sliceStem(std::string_view slice)
+{
+    if (slice.ends_with(SliceSuffix)) {
+        slice.remove_suffix(SliceSuffix.size());
+    }
+    return slice;
+}
+
+}
+
+
+std::string sanitizeUnitName(std::string_view name)
+{
+    // https://www.freedesktop.org/software/systemd/man/latest/systemd.unit.html#Description says:
+    //   The "unit name prefix" must consist of one or more valid characters
+    //   (ASCII letters, digits, ":", "-", "_", ".", and "\").
+    const auto isInvalidChar = [](char c) {
+        return !(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9')
+                 || (c != '\0' && std::strchr(":-_.\\", c) != nullptr));
+    };
+    std::string sanitized(name);
+    std::replace_if(sanitized.begin(), sanitized.end(), isInvalidChar, '_');
+    return sanitized;
+}
+
+
+std::string escapeUnitNameComponent(std::string_view name)
+{
+    std::string escaped;
+    escaped.reserve(name.size());
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        const char c = name[i];
+        if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9')
+            || c == ':' || c == '_' || (c == '.' && i != 0))
+        {
+            escaped += c;
+        }
+        else {
+            std::format_to(std::back_inserter(escaped), "\\x{:02x}", static_cast<unsigned char>(c));
+        }
+    }
+    return escaped;
+}
+
+
+std::string instanceUnitName(std::string_view prefix, std::uint64_t instance, bool isScope)
+{
+    if (isScope) {
+        return std::format("{}-{:016x}.scope", prefix, instance);
+    }
+    return std::format("{}@{:016x}.service", prefix, instance);
+}
+
+
+std::string_view unitNamePrefix(std::string_view unitName)
+{
+    return unitName.substr(0, unitName.find_last_of(unitName.ends_with(".scope") ? '-' : '@'));
+}
+
+
+std::string socketUnitName(std::string_view serviceName)
+{
+    return std::format("{}.socket", serviceName.substr(0, serviceName.rfind('.')));
+}
+
+
+std::string proxyUnitName(std::string_view serviceName)
+{
+    return std::format("{}-proxy.service", serviceName.substr(0, serviceName.rfind('.')));
+}
+
+
+std::string literalUnitNameGlob(std::string_view name)
+{
+    std::string glob;
+    for (const char c : name) {
+        if (c == '\\') {
+            glob += '\\';
+        }
+        glob += c;
+    }
+    return glob;
+}
+
+
+std::vector<std::string> unitNamePatterns(std::string_view prefix)
+{
+    const std::string p = literalUnitNameGlob(prefix);
+    // Matching instances (16 hex digits) and template hashes (8) exactly keeps the
+    // patterns from matching the units of apps whose names merely start the same.
+    const auto hexDigits = [](std::size_t count) {
+        std::string pattern;
+        for (std::size_t i = 0; i < count; ++i) {
+            pattern += "[0-9a-f]";
+        }
+        return pattern;
+    };
+    const std::string instance = hexDigits(16);
+    const std::string hash = hexDigits(8);
+    return {
+        std::format("{}@{}.service", p, instance),
+        std::format("{}@{}.socket", p, instance),
+        std::format("{}@{}-proxy.service", p, instance),
+        std::format("{}@{}-proxy.socket", p, instance),
+        std::format("{}-{}.scope", p, instance),
+        std::format("{}-{}@{}.service", p, hash, instance),
+        std::format("{}-{}-{}.scope", p, hash, instance),
+    };
+}
+
+
+std::string childSliceName(std::string_view slice, std::string_view component)
+{
+    const std::string_view stem = sliceStem(slice);
+    if (stem == "-" || stem.empty()) {
+        return std::format("{}{}", component, SliceSuffix);
+    }
+    return std::format("{}-{}{}", stem, component, SliceSuffix);
+}
+
+
+std::string sliceCgroupPath(std::string_view slice)
+{
+    const std::string_view stem = sliceStem(slice);
+    if (stem == "-" || stem.empty()) {
+        return {};
+    }
+
+    std::string path;
+    for (std::size_t dash = stem.find('-'); dash != std::string_view::npos;
+         dash = stem.find('-', dash + 1))
+    {
+        path.append(stem.substr(0, dash)).append(SliceSuffix).append("/");
+    }
+    return path.append(stem).append(SliceSuffix);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers for systemd unit names.
+
+// Return the given name with each character that is not valid in a unit name prefix
+// (ASCII letters, digits, ":", "-", "_", "." and "\") replaced by '_'.
+std::string sanitizeUnitName(std::string_view name);
+
+// Return the given name escaped for use as a component of a unit name, like
+// systemd-escape does: each character other than ASCII letters, digits, ":", "_" and
+// (except at the start) "." is replaced by its C-style "\xNN" escape, e.g. "a-b c"
+// by "a\x2db\x20c". Unlike with sanitizeUnitName(), distinct names stay distinct.
+std::string escapeUnitNameComponent(std::string_view name);
+
+// Return the name of the unit with the given prefix and instance (a random number):
+// "PREFIX@INSTANCE.service" or "PREFIX-INSTANCE.scope", with INSTANCE as 16 hex digits.
+std::string instanceUnitName(std::string_view prefix, std::uint64_t instance, bool isScope);
+
+// Return the prefix of the given unit name, as passed to instanceUnitName().
+std::string_view unitNamePrefix(std::string_view unitName);
+
+// Return the name of the socket unit for the given service with --socket, which
+// systemd pairs with the service by name.
+std::string socketUnitName(std::string_view serviceName);
+
+// Return the name of the proxy service for the given service with --idle-exit.
+std::string proxyUnitName(std::string_view serviceName);
+
+// Return a glob pattern (as for ListUnitsByPatterns) matching just the given unit name
+// (or prefix): unit names cannot contain glob characters, except for backslashes,
+// which are escaped.
+std::string literalUnitNameGlob(std::string_view name);
+
+// Return glob patterns (as for ListUnitsByPatterns) matching the names of all units
+// that runapp creates with the given prefix: services and scopes as per
+// instanceUnitName(), including template instances (see templateUnitPrefix()) and
+// the scopes of directly executed commands (see -x/--deadline-exec), and the socket
+// and proxy units of --socket and --idle-exit.
+std::vector<std::string> unitNamePatterns(std::string_view prefix);
+
+// Return the name of the child of the given slice with the given (dash-free) last
+// component, e.g. "app-graphical-group_x.slice" for "app-graphical.slice" and "group_x".
+std::string childSliceName(std::string_view slice, std::string_view component);
+
+// Return the path of the cgroup of the given slice, relative to that of the systemd
+// instance: each dash-separated prefix of a slice's name is a parent slice, so e.g.
+// "app-graphical.slice" lives in "app.slice/app-graphical.slice". Returns "" for the
+// root slice ("-.slice").
+std::string sliceCgroupPath(std::string_view slice);
@@ -1,6 +1,9 @@
+#pragma once
+
+#include "output.h"
+
 #include <format>
-#include <iostream>
-#include <print>
+#include <utility>
 
 inline bool g_verbose;
 
@@ -9,6 +12,6 @@ template<class... Args>
 void verbosePrintln(std::format_string<Args...> fmt, Args&&... args)
 {
     if (g_verbose) {
-        std::println(std::cout, fmt, std::forward<Args>(args)...);
+        fdPrintln(STDOUT_FILENO, fmt, std::forward<Args>(args)...);
     }
 }
@@ -0,0 +1,101 @@
+#include "arglist.h"
+#include "check.h"
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+
+std::vector<std::string> collect(const ArgList& list)
+{
+    std::vector<std::string> args;
+    list.forEach([&args](const char* arg) { args.emplace_back(arg); });
+    checkEqual(list.count(), args.size());
+    return args;
+}
+
+
+// Return the arguments in the given content, as loaded from a regular file (which is
+// memory-mapped) and from a pipe (which is read); check that both agree.
+std::vector<std::string> load(std::string_view content)
+{
+    char path[] = "/tmp/runapp-arglist-test.XXXXXX";
+    const int fd = mkstemp(path);
+    check(write(fd, content.data(), content.size()) == ssize_t(content.size()));
+    close(fd);
+    const std::vector<std::string> fromFile = collect(ArgList(path));
+    unlink(path);
+
+    // Written by a child process, as the content may not fit into the pipe buffer.
+    int pipeFds[2];
+    check(pipe(pipeFds) == 0);
+    const pid_t writer = fork();
+    if (writer == 0) {
+        close(pipeFds[0]);
+        _exit(write(pipeFds[1], content.data(), content.size()) == ssize_t(content.size()) ? 0 : 1);
+    }
+    close(pipeFds[1]);
+    const int savedStdin = dup(STDIN_FILENO);
+    dup2(pipeFds[0], STDIN_FILENO);
+    close(pipeFds[0]);
+    const std::vector<std::string> fromPipe = collect(ArgList("-"));
+    dup2(savedStdin, STDIN_FILENO);
+    close(savedStdin);
+    int status{};
+    check(waitpid(writer, &status, 0) == writer && status == 0);
+
+    check(fromFile == fromPipe);
+    return fromFile;
+}
+
+
+int main()
+{
+    using Args = std::vector<std::string>;
+
+    check(load("") == Args{});
+    check(load("one") == Args{"one"});
+    check(load(std::string_view("one\0", 4)) == Args{"one"});
+    check(load(std::string_view("one\0two words\0", 14)) == Args{"one", "two words"});
+    check(load(std::string_view("one\0two", 7)) == Args{"one", "two"});
+    // Empty fields are arguments too, including a trailing one.
+    check(load(std::string_view("\0", 1)) == Args{""});
+    check(load(std::string_view("one\0\0", 5)) == Args{"one", ""});
+    check(load(std::string_view("\0\0two\0", 6)) == Args{"", "", "two"});
+
+    // A large list, spanning many pages of the mapping.
+    std::string large;
+    for (int i = 0; i < 20000; ++i) {
+        large += "/home/user/Pictures/IMG_" + std::to_string(i) + ".jpg";
+        large += '\0';
+    }
+    const Args args = load(large);
+    checkEqual(args.size(), 20000u);
+    if (args.size() == 20000) {
+        checkEqual(args.back(), "/home/user/Pictures/IMG_19999.jpg");
+    }
+
+    // Standard input that is a regular file is mapped from its current offset.
+    char path[] = "/tmp/runapp-arglist-test.XXXXXX";
+    const int fd = mkstemp(path);
+    const std::string content = "skipped" + std::string(8192, 'x') + '\0' + "first" + '\0';
+    check(write(fd, content.data(), content.size()) == ssize_t(content.size()));
+    lseek(fd, 8192 + 8, SEEK_SET);
+    const int savedStdin = dup(STDIN_FILENO);
+    dup2(fd, STDIN_FILENO);
+    close(fd);
+    check(collect(ArgList("-")) == Args{"first"});
+    checkEqual(lseek(STDIN_FILENO, 0, SEEK_CUR), off_t(content.size()));
+    dup2(savedStdin, STDIN_FILENO);
+    close(savedStdin);
+    unlink(path);
+
+    return testResult();
+}
@@ -0,0 +1,73 @@
+#include "autostart.h"
+#include "check.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+
+void writeEntry(const fs::path& dir, std::string_view id, std::string_view keys)
+{
+    fs::create_directories(dir / "autostart");
+    std::ofstream(dir / "autostart" / (std::string(id) + ".desktop"))
+            << "[Desktop Entry]\nType=Application\n" << keys;
+}
+
+
+int main()
+{
+    char dir[] = "/tmp/runapp-autostart-test.XXXXXX";
+    if (!mkdtemp(dir)) {
+        return 1;
+    }
+    const fs::path home = fs::path(dir) / "home";
+    const fs::path system = fs::path(dir) / "system";
+    setenv("XDG_CONFIG_HOME", home.c_str(), 1);
+    setenv("XDG_CONFIG_DIRS", system.c_str(), 1);
+    setenv("XDG_CURRENT_DESKTOP", "sway:wlroots", 1);
+    setenv("PATH", "/bin:/usr/bin", 1);
+
+    writeEntry(system, "plain", "Name=Plain\nExec=plain --flag \"two words\" %U\n");
+    writeEntry(system, "late", "Exec=late\nX-Runapp-Priority=10\n");
+    writeEntry(system, "early", "Exec=early\nX-Runapp-Priority=-5\nPath=/tmp\n");
+    writeEntry(system, "hidden", "Exec=hidden\nHidden=true\n");
+    writeEntry(system, "only-sway", "Exec=only-sway\nOnlyShowIn=GNOME;wlroots;\n");
+    writeEntry(system, "only-gnome", "Exec=only-gnome\nOnlyShowIn=GNOME;\n");
+    writeEntry(system, "not-sway", "Exec=not-sway\nNotShowIn=sway;\n");
+    writeEntry(system, "try-found", "Exec=try-found\nTryExec=sh\n");
+    writeEntry(system, "try-missing", "Exec=try-missing\nTryExec=runapp-test-no-such-program\n");
+    writeEntry(system, "bad-priority", "Exec=bad-priority\nX-Runapp-Priority=high\n");
+    writeEntry(system, "no-exec", "Name=No Exec\n");
+    // An entry in $XDG_CONFIG_HOME overrides the system one, even if it is skipped itself.
+    writeEntry(system, "overridden", "Exec=overridden\n");
+    writeEntry(home, "overridden", "Exec=overridden\nHidden=true\n");
+    writeEntry(system, "user-changed", "Exec=system-version\n");
+    writeEntry(home, "user-changed", "Exec=user-version\n");
+
+    const std::vector<AutostartEntry> entries = findAutostartEntries();
+    std::vector<std::string> ids;
+    for (const AutostartEntry& entry : entries) {
+        ids.push_back(entry.id);
+    }
+    // Ordered by priority, then by ID.
+    check(ids == std::vector<std::string>{
+            "early", "only-sway", "plain", "try-found", "user-changed", "late"});
+
+    if (entries.size() == 6) {
+        checkEqual(entries[0].priority, -5);
+        checkEqual(entries[0].workingDir.value_or(""), "/tmp");
+        checkEqual(entries[0].name, "early");
+        checkEqual(entries[2].name, "Plain");
+        check(entries[2].exec == std::vector<std::string>{"plain", "--flag", "two words"});
+        check(entries[4].exec == std::vector<std::string>{"user-version"});
+        checkEqual(entries[5].priority, 10);
+    }
+
+    fs::remove_all(dir);
+    return testResult();
+}
@@ -0,0 +1,41 @@
+#include "auxunits.h"
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+
+void testSocketUnits()
+{
+    const char* const service = "app-sway-server@0123456789abcdef.service";
+
+    // Without --idle-exit, the app's service has the one socket unit.
+    SocketUnits units = describeSocketUnits(service, 0, "/run/user/1000", {});
+    checkEqual(units.listenerName, "app-sway-server@0123456789abcdef.socket");
+    check(units.backendName.empty() && units.backendPath.empty() && units.proxyName.empty());
+    check(units.proxyCommand.empty());
+
+    // With it, the listener belongs to the proxy, which the app's service (with a socket
+    // of its own) sits behind.
+    units = describeSocketUnits(service, 300, "/run/user/1000",
+                                "/usr/lib/systemd/systemd-socket-proxyd");
+    checkEqual(units.proxyName, "app-sway-server@0123456789abcdef-proxy.service");
+    checkEqual(units.listenerName, "app-sway-server@0123456789abcdef-proxy.socket");
+    checkEqual(units.backendName, "app-sway-server@0123456789abcdef.socket");
+    checkEqual(units.backendPath.native(), "/run/user/1000/runapp/0123456789abcdef.sock");
+    check(units.proxyCommand == std::vector<std::string>{
+            "/usr/lib/systemd/systemd-socket-proxyd", "--exit-idle-time=300s",
+            "/run/user/1000/runapp/0123456789abcdef.sock"});
+}
+
+
+int main()
+{
+    testSocketUnits();
+
+    check(boostEndCommand("app-sway-foot@0123456789abcdef.service") == std::vector<std::string>{
+            "systemctl", "--user", "set-property", "--runtime",
+            "app-sway-foot@0123456789abcdef.service", "CPUWeight=", "IOWeight="});
+
+    return testResult();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "output.h"
+
+#include <format>
+#include <source_location>
+
+// Minimal test harness: each test program calls check() and checkEqual() from its
+// main() and returns testResult(). Failures are reported, but do not abort the test.
+
+inline int g_checkFailures = 0;
+
+inline void check(bool condition, std::source_location loc = std::source_location::current())
+{
+    if (!condition) {
+        fdPrintln(STDERR_FILENO, "{}:{}: check failed", loc.file_name(), loc.line());
+        ++g_checkFailures;
+    }
+}
+
+template<class T, class U>
+void checkEqual(const T& actual, const U& expected,
+                std::source_location loc = std::source_location::current())
+{
+    if (!(actual == expected)) {
+        fdPrintln(STDERR_FILENO, "{}:{}: expected {}, got {}",
+                  loc.file_name(), loc.line(), expected, actual);
+        ++g_checkFailures;
+    }
+}
+
+inline int testResult()
+{
+    return g_checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+#include "check.h"
+#include "cmdline.h"
+
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+}
+
+
+// Parse the given command line (without argv[0]), with the usage and error messages
+// silenced.
+std::optional<CmdlineArgs> parse(std::initializer_list<const char*> args)
+{
+    // The result points into argv, so keep that alive.
+    static std::deque<std::vector<char*>> argvs;
+    std::vector<char*>& argv = argvs.emplace_back();
+    argv.push_back(const_cast<char*>("runapp"));
+    for (const char* arg : args) {
+        argv.push_back(const_cast<char*>(arg));
+    }
+    argv.push_back(nullptr);
+
+    const int savedStdout = dup(STDOUT_FILENO);
+    const int savedStderr = dup(STDERR_FILENO);
+    const int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+    close(devNull);
+    optind = 0;  // reinitialize getopt_long()
+    std::optional<CmdlineArgs> result = parseArgs(int(argv.size() - 1), argv.data());
+    dup2(savedStdout, STDOUT_FILENO);
+    dup2(savedStderr, STDERR_FILENO);
+    close(savedStdout);
+    close(savedStderr);
+    return result;
+}
+
+
+void testDeadline()
+{
+    // Without -x/--deadline-exec, runapp fails (and cancels the launch) at the deadline.
+    std::optional<CmdlineArgs> args = parse({"-D", "200", "foot"});
+    check(args && args->deadlineMs == 200u && !args->isDeadlineExec);
+    // With it, runapp executes the command directly.
+    args = parse({"--deadline=200", "--deadline-exec", "foot"});
+    check(args && args->deadlineMs == 200u && args->isDeadlineExec);
+    args = parse({"-o", "-D", "50", "-x", "foot", "--arg"});
+    check(args && args->isScope && args->isDeadlineExec && args->args.size() == 2);
+
+    check(!parse({"-D", "0", "foot"}));
+    check(!parse({"-D", "soon", "foot"}));
+    check(!parse({"-x", "foot"}));  // requires -D/--deadline
+    check(!parse({"-D", "200", "-x", "-f", "list", "imv"}));
+    check(!parse({"-D", "200", "-x", "--socket=8080", "server"}));
+    check(!parse({"-D", "200", "--autostart"}));
+}
+
+
+void testOutput()
+{
+    std::optional<OutputTarget> output = parseOutputTarget("journal");
+    check(output && output->kind == OutputTarget::Kind::Journal);
+    output = parseOutputTarget("null");
+    check(output && output->kind == OutputTarget::Kind::Null);
+    output = parseOutputTarget("file:/tmp/app.log");
+    check(output && output->kind == OutputTarget::Kind::File && output->path == "/tmp/app.log");
+    // Relative paths are made absolute, as the app runs elsewhere.
+    output = parseOutputTarget("file:app.log");
+    check(output && output->path.starts_with("/") && output->path.ends_with("/app.log"));
+    check(!parseOutputTarget("file:"));
+    check(!parseOutputTarget("inherit"));
+
+    std::optional<LogRateLimit> limit = parseLogRateLimit("30:1000");
+    check(limit && limit->intervalSec == 30 && limit->burst == 1000);
+    limit = parseLogRateLimit("0:0");
+    check(limit && limit->intervalSec == 0 && limit->burst == 0);
+    check(!parseLogRateLimit("30"));
+    check(!parseLogRateLimit("30:"));
+    check(!parseLogRateLimit(":1000"));
+    check(!parseLogRateLimit("30:1000:1"));
+    check(!parseLogRateLimit("-1:1000"));
+
+    checkEqual(parseLogLevel("emerg").value_or(-1), 0);
+    checkEqual(parseLogLevel("warning").value_or(-1), 4);
+    checkEqual(parseLogLevel("debug").value_or(-1), 7);
+    checkEqual(parseLogLevel("6").value_or(-1), 6);
+    check(!parseLogLevel("8"));
+    check(!parseLogLevel("warn"));
+    check(!parseLogLevel(""));
+
+    std::optional<CmdlineArgs> args =
+            parse({"-O", "null", "--log-rate-limit=10:100", "--log-level-max=err", "foot"});
+    check(args && args->output && args->output->kind == OutputTarget::Kind::Null);
+    check(args && args->logRateLimit && args->logRateLimit->burst == 100);
+    check(args && args->logLevelMax == 3);
+    check(parse({"-o", "-O", "null", "foot"}).has_value());
+    // journald applies these per unit, which scopes have no settings for.
+    check(!parse({"-o", "--log-rate-limit=10:100", "foot"}));
+    check(!parse({"-o", "--log-level-max=err", "foot"}));
+    check(!parse({"-O", "stdout", "foot"}));
+    check(!parse({"-O", "null", "-O", "journal", "foot"}));
+}
+
+
+void testDelegate()
+{
+    using Controllers = std::vector<std::string>;
+
+    std::optional<CmdlineArgs> args = parse({"foot"});
+    check(args && !args->delegateControllers);
+    // Without a list, all controllers are delegated.
+    args = parse({"--delegate", "foot"});
+    check(args && args->delegateControllers == Controllers{});
+    args = parse({"--delegate=memory,pids,memory", "foot"});
+    check(args && args->delegateControllers == Controllers{"memory", "pids"});
+
+    check(!parse({"--delegate=memory,", "foot"}));
+    check(!parse({"--delegate=devices", "foot"}));
+    check(!parse({"--delegate=", "foot"}));
+    check(!parse({"--delegate", "--delegate=cpu", "foot"}));
+}
+
+
+int main()
+{
+    const auto bytes = [](std::string_view value) {
+        return parseByteSize(value).value_or(UINT64_MAX);
+    };
+    checkEqual(bytes("0"), 0u);
+    checkEqual(bytes("4096"), 4096u);
+    checkEqual(bytes("512K"), 512u << 10);
+    checkEqual(bytes("2G"), std::uint64_t(2) << 30);
+    checkEqual(bytes("16777215T"), std::uint64_t(16777215) << 40);
+    check(!parseByteSize("16777216T"));  // overflows
+    check(!parseByteSize(""));
+    check(!parseByteSize("1k"));
+    check(!parseByteSize("1KB"));
+    check(!parseByteSize("-1"));
+    check(parseByteSize("infinity") == UINT64_MAX);
+    check(!parseByteSize("inf"));
+
+    checkEqual(parsePercentage("150").value_or(0), 150u);
+    checkEqual(parsePercentage("50%").value_or(0), 50u);
+    check(!parsePercentage("0"));
+    check(!parsePercentage("1.5"));
+    check(parsePercentage("infinity") == UINT_MAX);
+
+    testDeadline();
+    testOutput();
+    testDelegate();
+
+    return testResult();
+}
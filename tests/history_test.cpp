@@ -0,0 +1,50 @@
+#include "check.h"
+#include "history.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <string>
+
+namespace fs = std::filesystem;
+
+
+int main()
+{
+    char dir[] = "/tmp/runapp-history-test.XXXXXX";
+    if (!mkdtemp(dir)) {
+        return 1;
+    }
+    setenv("XDG_STATE_HOME", dir, 1);
+
+    check(readLaunchHistory().empty());
+
+    recordLaunch("first", "/usr/bin/first");
+    recordLaunch("second", "/usr/bin/second");
+    std::vector<LaunchRecord> records = readLaunchHistory();
+    checkEqual(records.size(), 2u);
+    if (records.size() == 2) {
+        checkEqual(records[0].app, "first");
+        checkEqual(records[0].path.native(), "/usr/bin/first");
+        checkEqual(records[1].app, "second");
+        check(records[0].timeUsec <= records[1].timeUsec);
+    }
+
+    // Paths that do not fit into a record are skipped.
+    recordLaunch("long", fs::path("/") / std::string(1000, 'x'));
+    checkEqual(readLaunchHistory().size(), 2u);
+
+    // Once full, the ring buffer keeps the most recent records, oldest first.
+    for (int i = 0; i < 600; ++i) {
+        recordLaunch(std::format("app{}", i), "/usr/bin/app");
+    }
+    records = readLaunchHistory();
+    checkEqual(records.size(), 512u);
+    if (records.size() == 512) {
+        checkEqual(records.front().app, "app88");
+        checkEqual(records.back().app, "app599");
+    }
+
+    fs::remove_all(dir);
+    return testResult();
+}
@@ -0,0 +1,70 @@
+#include "check.h"
+#include "jobtracker.h"
+
+#include <string>
+#include <vector>
+
+
+int main()
+{
+    JobList jobs;
+    std::vector<std::string> done;
+    const auto onDone = [&done](const JobList::Job& job) { done.push_back(job.path); };
+
+    const std::size_t start = jobs.add(onDone);
+    const std::size_t stop = jobs.add(onDone);
+    const std::size_t failed = jobs.add(onDone);
+    checkEqual(jobs.pendingCount(), 3u);
+
+    // A job cannot be matched before the reply has given its path.
+    jobs.jobRemoved("", "done");
+    checkEqual(jobs.pendingCount(), 3u);
+
+    jobs.replied(start, "/org/freedesktop/systemd1/job/10");
+    jobs.replied(stop, "/org/freedesktop/systemd1/job/11");
+    // Signals for jobs queued by other clients are ignored.
+    jobs.jobRemoved("/org/freedesktop/systemd1/job/9", "done");
+    checkEqual(jobs.pendingCount(), 3u);
+
+    jobs.jobRemoved("/org/freedesktop/systemd1/job/11", "canceled");
+    checkEqual(jobs[stop].result, "canceled");
+    check(!jobs[start].isDone());
+    check(done == std::vector<std::string>{"/org/freedesktop/systemd1/job/11"});
+
+    // A failed method call finishes the job with the error; an empty result is
+    // reported as unknown.
+    jobs.finish(failed, "Unit foo.service not found.");
+    checkEqual(jobs[failed].result, "Unit foo.service not found.");
+    const std::size_t unknown = jobs.add({});
+    jobs.replied(unknown, "/org/freedesktop/systemd1/job/12");
+    jobs.jobRemoved("/org/freedesktop/systemd1/job/12", "");
+    checkEqual(jobs[unknown].result, "unknown");
+    checkEqual(jobs.pendingCount(), 1u);
+
+    // A job is finished only once, even if its path shows up again.
+    jobs.jobRemoved("/org/freedesktop/systemd1/job/11", "done");
+    checkEqual(jobs[stop].result, "canceled");
+
+    // onDone may queue further jobs, which stay pending.
+    std::size_t followUp = 0;
+    const std::size_t chained = jobs.add([&](const JobList::Job&) {
+        followUp = jobs.add({});
+    });
+    jobs.replied(chained, "/org/freedesktop/systemd1/job/13");
+    jobs.jobRemoved("/org/freedesktop/systemd1/job/13", "done");
+    check(followUp > chained && !jobs[followUp].isDone());
+    checkEqual(jobs.pendingCount(), 2u);
+
+    const std::size_t unsent = jobs.add({});
+    jobs.removeLast();
+    check(unsent == followUp + 1);
+    checkEqual(jobs.pendingCount(), 2u);
+
+    jobs.finishAll("disconnected");
+    checkEqual(jobs[start].result, "disconnected");
+    checkEqual(jobs[followUp].result, "disconnected");
+    checkEqual(jobs[stop].result, "canceled");
+    checkEqual(jobs.pendingCount(), 0u);
+
+    return testResult();
+}
@@ -0,0 +1,132 @@
+#include "check.h"
+#include "latency.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+extern "C" {
+#include <unistd.h>
+}
+
+namespace fs = std::filesystem;
+
+
+void testBuckets()
+{
+    for (std::uint64_t usec = 0; usec < 8; ++usec) {
+        checkEqual(latencyBucketIndex(usec), usec);
+        checkEqual(latencyBucketUpperBound(usec), usec);
+    }
+    checkEqual(latencyBucketIndex(16), 16u);
+    checkEqual(latencyBucketIndex(17), 16u);
+    checkEqual(latencyBucketIndex(18), 17u);
+    checkEqual(latencyBucketUpperBound(16), 17u);
+
+    // Each value falls into the bucket whose range contains it, and buckets are at
+    // most 1/8 of their lower bound wide.
+    std::size_t prevIndex = 0;
+    for (std::uint64_t usec = 1; usec < (std::uint64_t(1) << 28); usec += 1 + usec / 64) {
+        const std::size_t index = latencyBucketIndex(usec);
+        check(index >= prevIndex);
+        check(latencyBucketUpperBound(index) >= usec);
+        check(index == 0 || latencyBucketUpperBound(index - 1) < usec);
+        const std::uint64_t lower = index == 0 ? 0 : latencyBucketUpperBound(index - 1) + 1;
+        check(latencyBucketUpperBound(index) - lower <= lower / 8);
+        prevIndex = index;
+    }
+
+    // The last bucket takes everything that is larger.
+    checkEqual(latencyBucketIndex(UINT64_MAX), latencyBucketIndex(std::uint64_t(1) << 40));
+}
+
+
+std::string captureReport()
+{
+    char path[] = "/tmp/runapp-latency-report.XXXXXX";
+    const int fd = mkstemp(path);
+    const int savedStdout = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    printLatencyReport(true);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    close(fd);
+
+    std::ifstream in(path);
+    std::string report(std::istreambuf_iterator<char>(in), {});
+    unlink(path);
+    return report;
+}
+
+
+void testEviction()
+{
+    char dir[] = "/tmp/runapp-latency-test.XXXXXX";
+    if (!mkdtemp(dir)) {
+        check(false);
+        return;
+    }
+    setenv("XDG_STATE_HOME", dir, 1);
+
+    const LatencyRecorder recorder;
+    const LaunchPhaseDurations durations{};
+    for (int i = 0; i < 256; ++i) {
+        recorder.record(std::format("app{}", i), "service", durations);
+    }
+    recorder.record("app0", "service", durations);  // now app1 is the least recently used
+    std::string report = captureReport();
+    check(report.starts_with("{\"slots\":256,\"slots_used\":256,\"evictions\":0,"));
+
+    recorder.record("new", "service", durations);
+    report = captureReport();
+    check(report.starts_with("{\"slots\":256,\"slots_used\":256,\"evictions\":1,"));
+    check(report.contains("\"app\":\"new\""));
+    check(report.contains("\"app\":\"app0\""));
+    check(!report.contains("\"app\":\"app1\""));
+    check(report.contains("\"app\":\"app2\""));
+    // The new entry starts afresh.
+    check(report.contains("\"app\":\"new\",\"mode\":\"service\",\"phases\":{\"connect\":{\"count\":1,"));
+
+    fs::remove_all(dir);
+}
+
+
+void testOlderLayout()
+{
+    char dir[] = "/tmp/runapp-latency-test.XXXXXX";
+    if (!mkdtemp(dir)) {
+        check(false);
+        return;
+    }
+    setenv("XDG_STATE_HOME", dir, 1);
+    fs::create_directories(fs::path(dir) / "runapp");
+    const fs::path path = fs::path(dir) / "runapp/latency";
+
+    // A file of layout version 1 reads as empty, and is replaced on the next launch.
+    std::ofstream(path) << "RNPPATL1" << std::string(4096, '\1');
+    check(captureReport().starts_with("{\"slots\":256,\"slots_used\":0,"));
+    LatencyRecorder().record("app", "scope", LaunchPhaseDurations{});
+    check(captureReport().starts_with("{\"slots\":256,\"slots_used\":1,\"evictions\":0,"));
+
+    // Anything else is left alone.
+    std::ofstream(path) << "something else";
+    LatencyRecorder().record("app", "scope", LaunchPhaseDurations{});
+    std::string content;
+    std::ifstream(path) >> content;
+    checkEqual(content, "something");
+
+    fs::remove_all(dir);
+}
+
+
+int main()
+{
+    testBuckets();
+    testEviction();
+    testOlderLayout();
+    return testResult();
+}
@@ -0,0 +1,54 @@
+#include "check.h"
+#include "template.h"
+
+#include <cstddef>
+#include <format>
+#include <string>
+#include <vector>
+
+
+int main()
+{
+    checkEqual(quoteExecWord("plain"), "\"plain\"");
+    checkEqual(quoteExecWord("a \"b\" c\\d"), "\"a \\\"b\\\" c\\\\d\"");
+    checkEqual(quoteExecWord("50% of $HOME\n"), "\"50%% of $$HOME\\n\"");
+
+    checkEqual(execWordLength("plain"), std::size_t(8));
+    checkEqual(execWordLength("50% \"$x\"\n"), std::size_t(19));
+    checkEqual(execWordLength("ä"), std::size_t(11));
+
+    // A large argument list, like 'find ~/Pictures -print0 | runapp -f - imv' makes:
+    // 20000 file names fit into an ExecStart= line, 40000 do not.
+    const auto totalLength = [](std::size_t count) {
+        std::size_t length = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            length += execWordLength(std::format("/home/user/Pictures/IMG_{:05}.jpg", i));
+        }
+        return length;
+    };
+    check(totalLength(20'000) < UnitFileMaxLineLength);
+    check(totalLength(40'000) > UnitFileMaxLineLength);
+
+    checkEqual(escapeUnitValue("My App"), "My App");
+    checkEqual(escapeUnitValue("100%\nsure"), "100%% sure");
+
+    checkEqual(quoteEnvFileValue("plain"), "\"plain\"");
+    checkEqual(quoteEnvFileValue("$HOME `x` \"y\" \\z"), "\"\\$HOME \\`x\\` \\\"y\\\" \\\\z\"");
+
+    const std::vector<const char*> args = {"--open", "two words", "q\"uote"};
+    const std::vector<const char*> env = {"LANG=C", "EMPTY=", "X=a=b $y"};
+    checkEqual(buildInstanceEnvFile(args, env),
+               "RUNAPP_ARGS=\"\\\"--open\\\" \\\"two words\\\" \\\"q\\\\\\\"uote\\\"\"\n"
+               "LANG=\"C\"\n"
+               "EMPTY=\"\"\n"
+               "X=\"a=b \\$y\"\n");
+    checkEqual(buildInstanceEnvFile({}, {}), "RUNAPP_ARGS=\"\"\n");
+
+    const std::string prefix = templateUnitPrefix("app-sway-foot", "[Service]\nA=1\n");
+    checkEqual(prefix.size(), std::string("app-sway-foot-").size() + 8);
+    check(prefix.starts_with("app-sway-foot-"));
+    checkEqual(templateUnitPrefix("app-sway-foot", "[Service]\nA=1\n"), prefix);
+    check(templateUnitPrefix("app-sway-foot", "[Service]\nA=2\n") != prefix);
+
+    return testResult();
+}
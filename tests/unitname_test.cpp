@@ -0,0 +1,88 @@
+#include "check.h"
+#include "template.h"
+#include "unitname.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" {
+#include <fnmatch.h>
+}
+
+
+// Return whether any of the given patterns matches the given name, as systemd's
+// ListUnitsByPatterns does.
+bool matchesAny(const std::vector<std::string>& patterns, const std::string& name)
+{
+    return std::ranges::any_of(patterns, [&name](const std::string& pattern) {
+        return fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+    });
+}
+
+
+void testUnitNamePatterns()
+{
+    const std::uint64_t instance = 0x0123456789abcdef;
+    const std::string service = instanceUnitName("app-sway-foot", instance, false);
+    const std::string scope = instanceUnitName("app-sway-foot", instance, true);
+    checkEqual(service, "app-sway-foot@0123456789abcdef.service");
+    checkEqual(scope, "app-sway-foot-0123456789abcdef.scope");
+    checkEqual(unitNamePrefix(service), "app-sway-foot");
+    checkEqual(unitNamePrefix(scope), "app-sway-foot");
+    checkEqual(socketUnitName(service), "app-sway-foot@0123456789abcdef.socket");
+    checkEqual(proxyUnitName(service), "app-sway-foot@0123456789abcdef-proxy.service");
+
+    const std::string templatePrefix = templateUnitPrefix("app-sway-foot", "[Service]\n");
+    const std::string instanceService = instanceUnitName(templatePrefix, instance, false);
+    checkEqual(unitNamePrefix(instanceService), templatePrefix);
+
+    // All units that runapp creates for the app...
+    const std::vector<std::string> patterns = unitNamePatterns("app-sway-foot");
+    for (const std::string& name : {
+             service, scope, socketUnitName(service), proxyUnitName(service),
+             socketUnitName(proxyUnitName(service)), instanceService,
+             instanceUnitName(unitNamePrefix(instanceService), instance, true)})
+    {
+        check(matchesAny(patterns, name));
+    }
+    // ... but not those of another app whose name starts the same.
+    for (const std::string_view other : {"app-sway-foot-server", "app-sway-foot-x", "app-sway-foot2"}) {
+        check(!matchesAny(patterns, instanceUnitName(other, instance, false)));
+        check(!matchesAny(patterns, instanceUnitName(other, instance, true)));
+        check(!matchesAny(patterns, instanceUnitName(templateUnitPrefix(other, ""), instance, true)));
+    }
+
+    // Backslashes (as in escaped names) match literally.
+    checkEqual(literalUnitNameGlob("group_a\\x2db.slice"), "group_a\\\\x2db.slice");
+    check(matchesAny({literalUnitNameGlob("group_a\\x2db.slice")}, "group_a\\x2db.slice"));
+    check(matchesAny(unitNamePatterns("app-a\\x2db"), instanceUnitName("app-a\\x2db", instance, true)));
+}
+
+
+int main()
+{
+    checkEqual(sanitizeUnitName("app-sway-org.gnome.Terminal"), "app-sway-org.gnome.Terminal");
+    checkEqual(sanitizeUnitName("app-my app/ä"), "app-my_app___");
+    checkEqual(sanitizeUnitName("a:b_c\\x2d"), "a:b_c\\x2d");
+
+    checkEqual(escapeUnitNameComponent("my.project_2:x"), "my.project_2:x");
+    checkEqual(escapeUnitNameComponent("a-b"), "a\\x2db");
+    checkEqual(escapeUnitNameComponent("a b"), "a\\x20b");
+    checkEqual(escapeUnitNameComponent(".a\\ä"), "\\x2ea\\x5c\\xc3\\xa4");
+
+    checkEqual(childSliceName("app-graphical.slice", "group_web"), "app-graphical-group_web.slice");
+    checkEqual(childSliceName("-.slice", "group_web"), "group_web.slice");
+
+    checkEqual(sliceCgroupPath("app.slice"), "app.slice");
+    checkEqual(sliceCgroupPath("app-graphical.slice"), "app.slice/app-graphical.slice");
+    checkEqual(sliceCgroupPath("app-graphical-group_web.slice"),
+               "app.slice/app-graphical.slice/app-graphical-group_web.slice");
+    checkEqual(sliceCgroupPath("-.slice"), "");
+
+    testUnitNamePatterns();
+
+    return testResult();
+}